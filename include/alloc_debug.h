@@ -0,0 +1,16 @@
+#ifndef _RKNN_DEMO_ALLOC_DEBUG_H_
+#define _RKNN_DEMO_ALLOC_DEBUG_H_
+
+#include <stdint.h>
+
+#ifdef YOLO11_ALLOC_DEBUG
+/**
+ * @brief Number of malloc/calloc/realloc calls made by the calling thread so far
+ *
+ * Only available when built with YOLO11_ALLOC_DEBUG, which interposes the
+ * glibc allocator entry points to count them.
+ */
+uint64_t alloc_debug_count();
+#endif
+
+#endif //_RKNN_DEMO_ALLOC_DEBUG_H_
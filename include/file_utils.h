@@ -14,6 +14,41 @@ extern "C" {
  */
 int read_data_from_file(const char *path, char **out_data);
 
+/**
+ * @brief Map a file read-only into memory instead of copying it to the heap
+ * 
+ * @param path [in] File path
+ * @param out_data [out] Mapped data, release with unmap_data_from_file()
+ * @return int -1: error; > 0: Mapped data size
+ */
+int mmap_data_from_file(const char *path, void **out_data);
+
+/**
+ * @brief Unmap data mapped by mmap_data_from_file()
+ * 
+ * @param data [in] Mapped data
+ * @param size [in] Mapped data size
+ */
+void unmap_data_from_file(void *data, int size);
+
+/**
+ * @brief Read a whole file into a caller provided buffer
+ * 
+ * @param path [in] File path
+ * @param buf [out] Destination buffer
+ * @param size [in] Bytes to read, usually the file size
+ * @return int 0: success; -1: error
+ */
+int read_file_to_buffer(const char *path, void *buf, int size);
+
+/**
+ * @brief Get the file size
+ * 
+ * @param path [in] File path
+ * @return int -1: error; >= 0: file size
+ */
+int get_file_size(const char *path);
+
 /**
  * @brief Write data to file
  * 
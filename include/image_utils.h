@@ -22,6 +22,8 @@ typedef struct {
     int x_pad;
     int y_pad;
     float scale;
+    int content_w; // size of the resized image inside the model input, 0 if unknown
+    int content_h;
 } letterbox_t;
 
 /**
@@ -65,6 +67,23 @@ int convert_image(image_buffer_t* src_image, image_buffer_t* dst_image, image_re
  */
 int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color);
 
+/**
+ * @brief Convert image with letterbox without waiting for RGA
+ * 
+ * The job is submitted with IM_ASYNC, the returned fence signals its completion
+ * and is owned by the caller. Without RGA the conversion is done synchronously
+ * and the fence is -1.
+ * 
+ * @param src_image [in] Source Image
+ * @param dst_image [out] Target Image
+ * @param letterbox [out] Letterbox
+ * @param color [in] Fill color on target image
+ * @param release_fence_fd [out] Completion fence, -1 if already complete
+ * @return int 
+ */
+int convert_image_with_letterbox_async(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color,
+                                       int* release_fence_fd);
+
 /**
  * @brief Get the image size
  * 
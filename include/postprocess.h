@@ -21,16 +21,58 @@ typedef struct {
     int cls_id;
 } object_detect_result;
 
-typedef struct {
+typedef struct object_detect_result_list {
     int id;
     int count;
     object_detect_result results[OBJ_NUMB_MAX_SIZE];
+    int preliminary;        // progressive mode: 1 for the coarsest branch list, 0 for the final one
+    float preliminary_ms;   // post process time to the preliminary list, 0 without one
+    float final_ms;         // post process time to the final list, 0 in a preliminary list
 } object_detect_result_list;
 
+// Candidate buffers reused by post_process, reserved for the worst case so that
+// the steady state does not touch the heap
+struct post_process_scratch {
+    std::vector<float> filterBoxes;
+    std::vector<float> objProbs;
+    std::vector<int> classId;
+    std::vector<int> indexArray;
+    std::vector<float> preliminaryProbs;
+    // quantized models: exp of the 256 int8 values of every box output (256 per
+    // output, indexed by output), empty when DFL decodes through compute_dfl
+    std::vector<float> dflExpLut;
+    // candidate ordering: quantSort when every score output is int8 with the same
+    // zp/scale, then scores are keyed on their int8 level
+    bool quantSort = false;
+    int32_t scoreZp = 0;
+    float scoreScale = 1.0f;
+    std::vector<uint8_t> sortKeys;
+    std::vector<float> sortProbs;
+    // NMS: boxes kept so far, per class
+    std::vector<float> nmsKept;
+};
+
 int init_post_process();
 void deinit_post_process();
 char *coco_cls_to_name(int cls_id);
 int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter_box, float conf_threshold, float nms_threshold, object_detect_result_list *od_results);
 
+int init_post_process_branches(rknn_app_context_t *app_ctx);
+// False when post_process can not decode an output in its native layout (zero
+// copy), init then binds that output in the plain layout of attr
+bool post_process_reads_native(const rknn_tensor_attr *attr, const rknn_tensor_attr *native_attr, uint32_t n_output);
+// True for an int8 fused head whose single scale can not resolve BOX_THRESH, init
+// then has the runtime convert that output to float
+bool post_process_needs_float(const rknn_tensor_attr *attr, uint32_t n_output);
+// Time the candidate sort on synthetic scores, YOLO11_BENCH_SORT in test.cpp
+int benchmark_post_process_sort(int candidates, int iterations);
+#ifdef YOLO11_POST_PROCESS_CHECK
+// Compare the optimized decoders against their plain versions on random data,
+// -1 on any mismatch, YOLO11_CHECK_POST_PROCESS in test.cpp
+int check_post_process(int iterations);
+#endif
+int init_post_process_scratch(rknn_app_context_t *app_ctx);
+void release_post_process_scratch(rknn_app_context_t *app_ctx);
+
 void deinitPostProcess();
 #endif //_RKNN_YOLO11_DEMO_POSTPROCESS_H_
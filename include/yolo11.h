@@ -18,6 +18,10 @@
 
 #include "rknn_api.h"
 #include "common.h"
+#include "image_utils.h"
+
+#define YOLO11_MAX_IO_SETS 4
+#define YOLO11_MAX_INPUT_RING 8
 
 #if defined(ZERO_COPY) 
     typedef struct {
@@ -25,8 +29,86 @@
         int dma_buf_fd;
         int size;
     }rknn_dma_buf;
+
+    // One in-flight frame of the async pipeline
+    typedef struct {
+        rknn_tensor_mem* input_mems[1];
+        rknn_tensor_mem* output_mems[9];
+        letterbox_t letter_box;
+        uint64_t frame_id;
+        double submit_ms;
+        double preprocess_ms;
+        int fence_fd; // NPU completion fence in fence mode, -1 otherwise
+        image_buffer_t* img; // source frame RGA may still read in fence mode, NULL once waited
+        uint64_t submit_allocs; // heap allocations of the submit, YOLO11_ALLOC_DEBUG
+    } yolo11_io_set_t;
 #endif
 
+typedef struct post_process_scratch post_process_scratch_t;
+typedef struct object_detect_result_list object_detect_result_list;
+
+// Receives the preliminary and the final detections of a progressive post process
+typedef void (*yolo11_result_cb_t)(const object_detect_result_list* results, void* user);
+
+/**
+ * @brief CPU side stage timings of the detector, in ms
+ *
+ */
+typedef struct {
+    double preprocess_ms;       // letterbox of the last frame
+    double npu_ms;              // rknn_run (or rknn_wait in async mode) of the last frame
+    double postprocess_ms;      // output decode and post_process of the last frame
+    double preprocess_sum_ms;
+    double npu_sum_ms;
+    double postprocess_sum_ms;
+    uint64_t frames;
+} yolo11_stage_times_t;
+
+/**
+ * @brief Where NPU internal and output tensors are placed
+ *
+ */
+typedef enum {
+    MEM_PLACEMENT_DRAM = 0,         // everything in DRAM
+    MEM_PLACEMENT_SRAM_INTERNAL,    // internal tensors in SRAM (RKNN_FLAG_ENABLE_SRAM)
+    MEM_PLACEMENT_SRAM_ALL,         // internal tensors and outputs in SRAM
+} mem_placement_t;
+
+/**
+ * @brief Cache policy of the output tensors read by post_process
+ *
+ */
+typedef enum {
+    OUTPUT_CACHE_DEFAULT = 0,   // rknn_create_mem, the runtime invalidates after each run
+    OUTPUT_CACHE_UNCACHED,      // non cacheable, no maintenance but every CPU read goes to DRAM
+    OUTPUT_CACHE_CACHED,        // cacheable, RKNN_FLAG_DISABLE_FLUSH_OUTPUT_MEM_CACHE and one
+                                // rknn_mem_sync per output per frame before decoding
+} output_cache_mode_t;
+
+/**
+ * @brief Scheduling class of a detector, maps to RKNN_FLAG_PRIOR_*
+ *
+ * High is the RKNN default. Under overload low priority frames are refused
+ * first, see yolo11_sched.h.
+ */
+typedef enum {
+    YOLO11_PRIORITY_HIGH = 0,
+    YOLO11_PRIORITY_MEDIUM,
+    YOLO11_PRIORITY_LOW,
+    YOLO11_PRIORITY_NUM,
+} yolo11_priority_t;
+
+/**
+ * @brief How init_yolo11_model gets the model file into rknn_init
+ *
+ */
+typedef enum {
+    MODEL_LOAD_AUTO = 0,        // zero copy, then mmap, then buffered
+    MODEL_LOAD_BUFFERED,        // read the file into a heap buffer
+    MODEL_LOAD_MMAP,            // map the file, no heap copy
+    MODEL_LOAD_ZERO_COPY,       // read into NPU memory, init with RKNN_FLAG_MODEL_BUFFER_ZERO_COPY
+} model_load_mode_t;
+
 typedef struct {
     rknn_context rknn_ctx;
     rknn_input_output_num io_num;
@@ -44,7 +126,89 @@ typedef struct {
     rknn_tensor_attr* output_native_attrs;
     // add
     rknn_dma_buf img_dma_buf;
+    // async pipeline, set async_depth >= 2 before init_yolo11_model to enable it.
+    // io_sets[0] aliases input_mems/output_mems.
+    int async_depth;
+    // fence mode, set before init_yolo11_model: the RGA release fence gates the
+    // NPU job (RKNN_FLAG_FENCE_IN_OUTSIDE) and async_wait polls the NPU output
+    // fence (RKNN_FLAG_FENCE_OUT_OUTSIDE) instead of blocking on each stage
+    bool use_fence;
+    yolo11_io_set_t io_sets[YOLO11_MAX_IO_SETS];
+    int io_set_head;
+    int io_set_tail;
+    int io_set_pending;
+    // input ring, set input_ring_size > 0 before init_yolo11_model (at least 3 and
+    // one more than async_depth are used). Each frame is letterboxed into the next
+    // DMA heap buffer, imported once with rknn_create_mem_from_fd and rebound with
+    // rknn_set_io_mem, so RGA fills one buffer while the NPU reads another.
+    // input_mems[0] then aliases the buffer of the last frame.
+    int input_ring_size;
+    int input_ring_next;
+    rknn_dma_buf input_ring[YOLO11_MAX_INPUT_RING];
+    rknn_tensor_mem* input_ring_mems[YOLO11_MAX_INPUT_RING];
+    // per-frame output copies, allocated once from output_native_attrs
+    int8_t* output_bufs[9];
+    // bytes of the output memory that landed in SRAM
+    uint32_t output_sram_size;
 #endif
+    // set before init_yolo11_model, falls back to MEM_PLACEMENT_DRAM without SRAM
+    mem_placement_t mem_placement;
+    bool share_sram;
+    // set before init_yolo11_model
+    output_cache_mode_t output_cache_mode;
+    // the input memory is only written by RGA, never by the CPU, so the runtime
+    // can skip its input cache flush (RKNN_FLAG_DISABLE_FLUSH_INPUT_MEM_CACHE)
+    bool device_written_input;
+    // set before init_yolo11_model
+    yolo11_priority_t priority;
+    // deadline of a blocking rknn_run/rknn_wait handed to the driver
+    // (rknn_run_extend.timeout_ms), the run then fails with RKNN_ERR_TIMEOUT. 0: none
+    int run_timeout_ms;
+    // detection branches to decode, set before init_yolo11_model. Bit i of
+    // branch_mask is the i-th branch in output order (0: all); min_object_size
+    // (model input pixels) also drops the fine branches that only find smaller
+    // objects. Skipped branches are neither copied, synced nor scanned.
+    uint32_t branch_mask;
+    int min_object_size;
+    // branch layout found in the output attributes at init, 0 branches for a fused head
+    int n_branch;
+    int output_per_branch;
+    uint32_t active_branches;
+    int coarsest_branch;
+    // progressive mode, set progressive_cb to have post_process decode the
+    // coarsest branch first and hand its NMS'd detections to the callback
+    // (preliminary = 1) before the finer branches, then the final list again.
+    // Called on the thread running post_process.
+    yolo11_result_cb_t progressive_cb;
+    void* progressive_user;
+    // reusable post process buffers, allocated once at init
+    post_process_scratch_t* pp_scratch;
+    // heap allocations of the last frame, from letterbox to the detect results,
+    // only counted with YOLO11_ALLOC_DEBUG
+    uint64_t frame_alloc_count;
+    uint64_t frame_count;
+    // set before init_yolo11_model, reports the mode actually used afterwards
+    model_load_mode_t model_load_mode;
+    // model buffer referenced by a zero-copy context, lives as long as rknn_ctx
+    rknn_tensor_mem* model_mem;
+    double model_load_ms;
+    double model_init_ms;
+    // profiling, set before init_yolo11_model. With collect_perf the context is
+    // created with RKNN_FLAG_COLLECT_PERF_MASK and every perf_report_interval
+    // frames a per-layer report is written to perf_report_path
+    bool collect_perf;
+    int perf_report_interval;
+    const char* perf_report_path;
+    yolo11_stage_times_t stage_times;
+    // dynamic shape models (RKNN_QUERY_INPUT_DYNAMIC_RANGE), io memory is sized
+    // for the largest shape and dyn_shape_index is the shape currently set
+    bool is_dynamic;
+    rknn_input_range* dyn_range;
+    int dyn_shape_index;
+    // batch exported models, set batch_core_num before init_yolo11_model to
+    // choose how many NPU cores a batched run is spread over (0: up to 3)
+    int batch_core_num;
+    int model_batch;
     int model_channel;
     int model_width;
     int model_height;
@@ -56,8 +220,98 @@ typedef struct {
 
 int init_yolo11_model(const char* model_path, rknn_app_context_t* app_ctx);
 
+/**
+ * @brief Create a sibling detector for another stream of the same model
+ *
+ * The context is created with RKNN_FLAG_SHARE_WEIGHT_MEM and reuses the weight
+ * allocation of primary_ctx, internal and io memory are its own. The options
+ * of app_ctx (async depth...) apply as for init_yolo11_model, except that the
+ * model is always loaded through mmap (buffered as fallback) and unmapped after
+ * rknn_init: a zero copy model buffer would keep a weight sized copy per sibling.
+ *
+ * The weights belong to primary_ctx, it must outlive all of its siblings.
+ *
+ * @param model_path [in] Model path, the same model as primary_ctx
+ * @param primary_ctx [in] Initialized detector owning the weights
+ * @param app_ctx [out] Sibling detector, release it before primary_ctx
+ * @return int 0: success; -1: error
+ */
+int init_yolo11_model_shared(const char* model_path, rknn_app_context_t* primary_ctx, rknn_app_context_t* app_ctx);
+
+/**
+ * @brief Print the weight/internal/io memory used by a detector (RKNN_QUERY_MEM_SIZE)
+ *
+ * @param app_ctx [in] Initialized detector
+ * @return int 0: success; -1: error
+ */
+int dump_yolo11_mem_size(rknn_app_context_t* app_ctx);
+
+/**
+ * @brief Create a new detector that shares the weights of an initialized one
+ *
+ * @param src_ctx [in] Initialized detector
+ * @param dst_ctx [out] Duplicated detector with its own io memory
+ * @param core_mask [in] NPU core the duplicated context is pinned to
+ * @return int 0: success; -1: error
+ */
+int dup_yolo11_model(rknn_app_context_t* src_ctx, rknn_app_context_t* dst_ctx, rknn_core_mask core_mask);
+
+/**
+ * @brief Switch a dynamic shape model to the input shape that suits a source
+ *
+ * Picks the shape that wastes the least letterbox padding for the source
+ * aspect ratio, the smallest one on ties, and sets it with rknn_set_input_shapes.
+ * model_width/model_height and the output attributes used by post_process are
+ * updated. Does nothing for static models.
+ *
+ * @param app_ctx [in] Initialized detector without frames in flight
+ * @param src_width [in] Source image width
+ * @param src_height [in] Source image height
+ * @return int 0: success; -1: error
+ */
+int select_yolo11_input_shape(rknn_app_context_t* app_ctx, int src_width, int src_height);
+
 int release_yolo11_model(rknn_app_context_t* app_ctx);
 
 int inference_yolo11_model(rknn_app_context_t* app_ctx, image_buffer_t* img, object_detect_result_list* od_results);
 
+#if defined(ZERO_COPY)
+/**
+ * @brief Letterbox a frame into a free io set and start it on the NPU without waiting
+ *
+ * @param app_ctx [in] Detector initialized with async_depth >= 2
+ * @param img [in] Source image. Without use_fence it may be reused as soon as the
+ *                call returns. With use_fence RGA reads it asynchronously, so it is
+ *                held until async_wait returns this frame.
+ * @param frame_id [out] Frame id reported by rknn_run, may be NULL
+ * @return int 0: success; -1: error or all io sets in flight;
+ *             YOLO11_FRAME_DROPPED (yolo11_sched.h): refused by the admission policy
+ */
+int inference_yolo11_model_async_submit(rknn_app_context_t* app_ctx, image_buffer_t* img, uint64_t* frame_id);
+
+/**
+ * @brief Wait for the oldest submitted frame and post process it
+ *
+ * @param app_ctx [in] Detector initialized with async_depth >= 2
+ * @param od_results [out] Detect results
+ * @param frame_id [out] Frame id of the results, may be NULL
+ * @return int 0: success; -1: error or nothing in flight
+ */
+int inference_yolo11_model_async_wait(rknn_app_context_t* app_ctx, object_detect_result_list* od_results, uint64_t* frame_id);
+
+/**
+ * @brief Run several frames through a batch exported model in one rknn_run
+ *
+ * Frame i is letterboxed into slot i of the batched input memory and gets the
+ * detections of output slice i. Slots past n are run with stale content.
+ *
+ * @param app_ctx [in] Detector of a model with model_batch >= n
+ * @param imgs [in] Source images
+ * @param n [in] Number of frames
+ * @param od_results [out] Detect results, n entries
+ * @return int 0: success; -1: error; YOLO11_FRAME_DROPPED: refused by the admission policy
+ */
+int inference_yolo11_model_batch(rknn_app_context_t* app_ctx, image_buffer_t** imgs, int n, object_detect_result_list* od_results);
+#endif
+
 #endif //_RKNN_DEMO_YOLO11_H_
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef _RKNN_DEMO_YOLO11_PERF_H_
+#define _RKNN_DEMO_YOLO11_PERF_H_
+
+#include "yolo11.h"
+
+/**
+ * @brief Write a per-layer NPU profile and the CPU stage timings as CSV
+ *
+ * Queries RKNN_QUERY_PERF_RUN and RKNN_QUERY_PERF_DETAIL, the latter needs the
+ * context to be created with collect_perf. Rows are tagged by a section column:
+ * "layer" for every network layer (cpu_fallback=1 when it did not run on the
+ * NPU), "run" for the last rknn_run duration and "stage" for the CPU timings.
+ *
+ * @param app_ctx [in] Detector
+ * @param path [in] CSV file, overwritten
+ * @return int 0: success; -1: error
+ */
+int dump_yolo11_perf(rknn_app_context_t* app_ctx, const char* path);
+
+#if defined(ZERO_COPY)
+/**
+ * @brief Time the CPU reads of post_process from uncached and cached output memory
+ *
+ * Runs the model once, copies its outputs into a non cacheable and a cacheable
+ * copy of every output tensor and times a sequential read and the full decode
+ * over each. The cached figures include the rknn_mem_sync of every frame.
+ *
+ * @param app_ctx [in] Initialized detector
+ * @param iterations [in] Frames timed per placement
+ * @return int 0: success; -1: error
+ */
+int benchmark_yolo11_output_reads(rknn_app_context_t* app_ctx, int iterations);
+
+/**
+ * @brief Time rknn_run and the input cache flush that device_written_input removes
+ *
+ * The flush is measured as an explicit rknn_mem_sync(TO_DEVICE) of the input
+ * memory, the work the runtime does before every run without the flag. Compare
+ * the rknn_run figure of two runs with and without device_written_input.
+ *
+ * @param app_ctx [in] Initialized detector
+ * @param iterations [in] Frames timed
+ * @return int 0: success; -1: error
+ */
+int benchmark_yolo11_input_flush(rknn_app_context_t* app_ctx, int iterations);
+#endif
+
+#endif //_RKNN_DEMO_YOLO11_PERF_H_
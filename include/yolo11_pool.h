@@ -0,0 +1,58 @@
+#ifndef _RKNN_DEMO_YOLO11_POOL_H_
+#define _RKNN_DEMO_YOLO11_POOL_H_
+
+#include <stdint.h>
+#include "yolo11.h"
+
+/**
+ * @brief How frames are handed out to the pool workers
+ *
+ */
+typedef enum {
+    YOLO11_POOL_ROUND_ROBIN,
+    YOLO11_POOL_LEAST_BUSY,
+} yolo11_pool_policy_t;
+
+typedef struct yolo11_pool yolo11_pool_t;
+
+/**
+ * @brief Create a detector pool, one context per NPU core
+ *
+ * The model is loaded once, the other workers are created with rknn_dup_context
+ * and worker i is pinned to NPU core (i % 3).
+ *
+ * @param model_path [in] Model path
+ * @param n_workers [in] Number of contexts (3 on RK3588)
+ * @param policy [in] Frame dispatch policy
+ * @param pool [out] Created pool
+ * @return int 0: success; -1: error
+ */
+int init_yolo11_pool(const char* model_path, int n_workers, yolo11_pool_policy_t policy, yolo11_pool_t** pool);
+
+/**
+ * @brief Queue a frame for inference
+ *
+ * The image is not copied, it must stay valid until its result has been fetched.
+ *
+ * @param pool [in] Pool
+ * @param img [in] Source image
+ * @param frame_id [out] Sequence number of the frame, may be NULL
+ * @return int 0: success; -1: error
+ */
+int yolo11_pool_submit(yolo11_pool_t* pool, image_buffer_t* img, uint64_t* frame_id);
+
+/**
+ * @brief Wait for the result of the oldest pending frame
+ *
+ * Results are returned in submit order regardless of which worker finished first.
+ *
+ * @param pool [in] Pool
+ * @param od_results [out] Detect results
+ * @param frame_id [out] Sequence number of the frame, may be NULL
+ * @return int inference return code of the frame; -1: nothing pending
+ */
+int yolo11_pool_get_result(yolo11_pool_t* pool, object_detect_result_list* od_results, uint64_t* frame_id);
+
+int release_yolo11_pool(yolo11_pool_t* pool);
+
+#endif //_RKNN_DEMO_YOLO11_POOL_H_
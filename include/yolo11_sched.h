@@ -0,0 +1,58 @@
+#ifndef _RKNN_DEMO_YOLO11_SCHED_H_
+#define _RKNN_DEMO_YOLO11_SCHED_H_
+
+#include <stdint.h>
+#include "yolo11.h"
+
+// returned by the inference calls when the admission policy refused the frame
+#define YOLO11_FRAME_DROPPED 1
+
+typedef struct {
+    uint64_t frames;    // completed frames
+    uint64_t dropped;   // frames refused by the admission policy
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+} yolo11_latency_stats_t;
+
+/**
+ * @brief Limit the frames in flight over all detectors of the process
+ *
+ * Frames are admitted by priority: high always, medium while fewer than
+ * max_inflight frames are running and low while fewer than half of it are,
+ * so best-effort streams are dropped first when the NPU saturates.
+ *
+ * @param max_inflight [in] In-flight limit, 0 disables admission control
+ */
+void set_yolo11_admission_limit(int max_inflight);
+
+/**
+ * @brief Try to start a frame of the given priority
+ *
+ * @return int 0: admitted, call yolo11_sched_finish afterwards; YOLO11_FRAME_DROPPED: refused
+ */
+int yolo11_sched_admit(yolo11_priority_t priority);
+
+/**
+ * @brief Account an admitted frame as done and record its latency
+ *
+ * @param priority [in] Priority the frame was admitted with
+ * @param latency_ms [in] Time from submission to results, < 0 when it failed
+ */
+void yolo11_sched_finish(yolo11_priority_t priority, double latency_ms);
+
+/**
+ * @brief Latency percentiles of one priority class since the last reset
+ *
+ * @param priority [in] Priority class
+ * @param stats [out] Counters, percentiles have a 0.1 ms resolution
+ * @return int 0: success; -1: error
+ */
+int get_yolo11_latency_stats(yolo11_priority_t priority, yolo11_latency_stats_t* stats);
+
+void reset_yolo11_latency_stats();
+
+// Print frames, drops and p50/p99/max latency of every priority class
+void dump_yolo11_latency_stats();
+
+#endif //_RKNN_DEMO_YOLO11_SCHED_H_
@@ -0,0 +1,67 @@
+#ifndef _RKNN_DEMO_YOLO11_WATCHDOG_H_
+#define _RKNN_DEMO_YOLO11_WATCHDOG_H_
+
+#include <stdint.h>
+#include "yolo11.h"
+#include "yolo11_sched.h"
+
+typedef struct yolo11_watchdog yolo11_watchdog_t;
+
+typedef struct {
+    uint64_t frames;            // frames that returned results
+    uint64_t failures;          // deadline misses and driver timeouts/resets
+    uint64_t recoveries;        // contexts rebuilt after a failure
+    uint64_t dropped;           // frames refused while a context was rebuilt
+    double last_recovery_ms;    // from the failure to a context ready again
+    double max_recovery_ms;
+} yolo11_watchdog_stats_t;
+
+/**
+ * @brief Create a detector whose inference runs under a deadline
+ *
+ * Inference runs on a worker thread with timeout_ms handed to the driver
+ * (run_timeout_ms) and a host side deadline slightly above it. When a frame
+ * misses the deadline or the driver reports a timeout or reset, the context is
+ * dropped and a new one, io memory bindings included, is built in the
+ * background from model_path. Frames arriving in the meantime are refused at
+ * once, so the caller (camera loop) never blocks on a broken NPU.
+ *
+ * A context stuck inside the driver can not be destroyed, its worker thread is
+ * detached and releases it if the call ever returns.
+ *
+ * @param model_path [in] Model path
+ * @param options [in] Detector options applied to every context (load mode, priority...), may be NULL.
+ *                    Only the fields set before init_yolo11_model are read, the
+ *                    context itself is never shared with the runners
+ * @param timeout_ms [in] Deadline of one rknn_run
+ * @param wd [out] Created watchdog
+ * @return int 0: success; -1: error
+ */
+int init_yolo11_watchdog(const char* model_path, const rknn_app_context_t* options, int timeout_ms,
+                         yolo11_watchdog_t** wd);
+
+/**
+ * @brief Run one frame under the deadline, from one caller thread
+ *
+ * When the frame misses the deadline (RKNN_ERR_TIMEOUT), the abandoned context
+ * may still be reading img, in RGA or on the NPU. The caller must keep that
+ * frame buffer alive, and not refill it, until
+ * get_yolo11_watchdog_hung_contexts() drops back, or for the process lifetime
+ * if it never does. For every other return img is no longer referenced.
+ *
+ * @param wd [in] Watchdog
+ * @param img [in] Source image
+ * @param od_results [out] Detect results
+ * @return int 0: success; YOLO11_FRAME_DROPPED: no context available, a rebuild is running;
+ *             < 0: the frame failed, a failure of the NPU starts a rebuild
+ */
+int yolo11_watchdog_inference(yolo11_watchdog_t* wd, image_buffer_t* img, object_detect_result_list* od_results);
+
+int get_yolo11_watchdog_stats(yolo11_watchdog_t* wd, yolo11_watchdog_stats_t* stats);
+
+// Abandoned contexts (over all watchdogs) still inside a call that missed its deadline
+int get_yolo11_watchdog_hung_contexts();
+
+int release_yolo11_watchdog(yolo11_watchdog_t* wd);
+
+#endif //_RKNN_DEMO_YOLO11_WATCHDOG_H_
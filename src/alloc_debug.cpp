@@ -0,0 +1,40 @@
+#include "alloc_debug.h"
+
+#ifdef YOLO11_ALLOC_DEBUG
+
+#include <stddef.h>
+
+// glibc internal entry points, used to forward the interposed calls
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t nmemb, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+// per thread, so the frame of one detector is not charged for the
+// allocations of other threads (camera loop, pool workers, watchdog)
+static thread_local uint64_t g_alloc_count = 0;
+
+// operator new ends up in malloc, so C++ containers are counted as well
+extern "C" void *malloc(size_t size)
+{
+    g_alloc_count++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size)
+{
+    g_alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    g_alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+uint64_t alloc_debug_count()
+{
+    return g_alloc_count;
+}
+
+#endif
@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "file_utils.h"
 
 #define MAX_TEXT_LINE_LENGTH 1024
@@ -57,6 +61,78 @@ int read_data_from_file(const char *path, char **out_data)
     return file_size;
 }
 
+int get_file_size(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        printf("stat %s fail!\n", path);
+        return -1;
+    }
+    return (int)st.st_size;
+}
+
+int mmap_data_from_file(const char *path, void **out_data)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        printf("fstat %s fail!\n", path);
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the fd is closed
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("mmap %s fail!\n", path);
+        return -1;
+    }
+    // the whole file is consumed right away, let the kernel read ahead
+    madvise(data, st.st_size, MADV_WILLNEED);
+    *out_data = data;
+    return (int)st.st_size;
+}
+
+void unmap_data_from_file(void *data, int size)
+{
+    if (data != NULL && size > 0)
+    {
+        munmap(data, size);
+    }
+}
+
+int read_file_to_buffer(const char *path, void *buf, int size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    int offset = 0;
+    while (offset < size)
+    {
+        ssize_t n = read(fd, (char *)buf + offset, size - offset);
+        if (n <= 0)
+        {
+            printf("read %s fail!\n", path);
+            close(fd);
+            return -1;
+        }
+        offset += n;
+    }
+    close(fd);
+    return 0;
+}
+
 int write_data_to_file(const char *path, const char *data, unsigned int size)
 {
     FILE *fp;
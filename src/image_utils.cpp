@@ -1,6 +1,7 @@
 #include "image_utils.h"
 #include <cstddef>
 #include "im2d.h"
+#include "dma_alloc.h"
 #include <fstream>
 
 #include <sstream>
@@ -8,6 +9,7 @@
 #include <string>
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include <unistd.h>
 
 int draw_text(image_buffer_t* src_image, const char* text, int x, int y, int color, int font_size)
 {
@@ -346,7 +348,10 @@ static int get_rga_fmt(image_format_t fmt) {
     }
 }
 
-static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
+// release_fence_fd != NULL submits the fill and the process as IM_ASYNC jobs,
+// chained through the fill fence, and returns the fence of the last one
+static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color,
+                             int* release_fence_fd)
 {
     int ret = 0;
 
@@ -375,6 +380,7 @@ static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, i
     // printf("rotate=%d\n", rotate);
 
     int usage = 0;
+    int fill_fence_fd = -1;
     IM_STATUS ret_rga = IM_STATUS_NOERROR;
 
     // set rga usage
@@ -486,11 +492,19 @@ static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, i
         p_imcolor[3] = color;
         printf("fill dst image (x y w h)=(%d %d %d %d) with color=0x%x\n",
             dst_whole_rect.x, dst_whole_rect.y, dst_whole_rect.width, dst_whole_rect.height, imcolor);
-        ret_rga = imfill(rga_buf_dst, dst_whole_rect, imcolor);
+        if (release_fence_fd != NULL) {
+            ret_rga = imfill(rga_buf_dst, dst_whole_rect, imcolor, 0, &fill_fence_fd);
+        } else {
+            ret_rga = imfill(rga_buf_dst, dst_whole_rect, imcolor);
+        }
         if (ret_rga <= 0) {
             if (dst != NULL) {
                 size_t dst_size = get_image_size(dst_img);
                 memset(dst, color, dst_size);
+                // the NPU may be told not to flush its input, push the CPU fill out now
+                if (dst_fd > 0) {
+                    dma_sync_cpu_to_device(dst_fd);
+                }
             } else {
                 printf("Warning: Can not fill color on target image\n");
             }
@@ -498,7 +512,16 @@ static int convert_image_rga(image_buffer_t* src_img, image_buffer_t* dst_img, i
     }
 
     // rga process
-    ret_rga = improcess(rga_buf_src, rga_buf_dst, pat, srect, drect, prect, usage);
+    if (release_fence_fd != NULL) {
+        *release_fence_fd = -1;
+        ret_rga = improcess(rga_buf_src, rga_buf_dst, pat, srect, drect, prect, fill_fence_fd, release_fence_fd, NULL,
+                            usage | IM_ASYNC);
+        if (fill_fence_fd >= 0) {
+            close(fill_fence_fd);
+        }
+    } else {
+        ret_rga = improcess(rga_buf_src, rga_buf_dst, pat, srect, drect, prect, usage);
+    }
     if (ret_rga <= 0) {
         printf("Error on improcess STATUS=%d\n", ret_rga);
         printf("RGA error message: %s\n", imStrError((IM_STATUS)ret_rga));
@@ -607,12 +630,16 @@ int convert_image_opencv(image_buffer_t* src_img, image_buffer_t* dst_img, image
 }
 
 
-int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
+static int convert_image_fence(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color,
+                               int* release_fence_fd)
 {
     int ret;
+    if (release_fence_fd != NULL) {
+        *release_fence_fd = -1;
+    }
 #ifdef USE_RGA
     if(src_img->width % 16 == 0 && dst_img->width % 16 == 0) {
-        ret = convert_image_rga(src_img, dst_img, src_box, dst_box, color);
+        ret = convert_image_rga(src_img, dst_img, src_box, dst_box, color, release_fence_fd);
         if (ret != 0) {
             printf("convert image use rga failed\n");
             return -1;
@@ -627,6 +654,11 @@ int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t
     return ret;
 }
 
+int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
+{
+    return convert_image_fence(src_img, dst_img, src_box, dst_box, color, NULL);
+}
+
 // int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t* src_box, image_rect_t* dst_box, char color)
 // {
 //     if (!src_img || !dst_img || src_img->format != dst_img->format) {
@@ -714,7 +746,8 @@ int convert_image(image_buffer_t* src_img, image_buffer_t* dst_img, image_rect_t
 //     return 0;
 // }
 
-int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+static int convert_image_with_letterbox_fence(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color,
+                                              int* release_fence_fd)
 {
     int ret = 0;
     int allow_slight_change = 1;
@@ -794,6 +827,8 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
         letterbox->scale = scale;
         letterbox->x_pad = _left_offset;
         letterbox->y_pad = _top_offset;
+        letterbox->content_w = dst_box.right - dst_box.left + 1;
+        letterbox->content_h = dst_box.bottom - dst_box.top + 1;
     }
     // alloc memory buffer for dst image,
     // remember to free
@@ -805,6 +840,17 @@ int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_
             return -1;
         }
     }
-    ret = convert_image(src_image, dst_image, &src_box, &dst_box, color);
+    ret = convert_image_fence(src_image, dst_image, &src_box, &dst_box, color, release_fence_fd);
     return ret;
+}
+
+int convert_image_with_letterbox(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color)
+{
+    return convert_image_with_letterbox_fence(src_image, dst_image, letterbox, color, NULL);
+}
+
+int convert_image_with_letterbox_async(image_buffer_t* src_image, image_buffer_t* dst_image, letterbox_t* letterbox, char color,
+                                       int* release_fence_fd)
+{
+    return convert_image_with_letterbox_fence(src_image, dst_image, letterbox, color, release_fence_fd);
 }
\ No newline at end of file
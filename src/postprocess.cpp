@@ -21,8 +21,15 @@
 #include <string.h>
 #include <sys/time.h>
 
-#include <set>
+#include <algorithm>
 #include <vector>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+// largest tolerated DFL decode difference of the lookup table path, in grid cells
+#define DFL_LUT_MAX_ERR 1e-3f
+// largest int8 step of a fused head's scores, relative to BOX_THRESH
+#define FUSED_MAX_SCORE_STEP 0.1f
 #define LABEL_NALE_TXT_PATH "../config/coco_80_labels_list.txt"
 
 static char *labels[OBJ_CLASS_NUM];
@@ -96,85 +103,65 @@ static int loadLabelName(const char *locationFilename, char *label[])
     return 0;
 }
 
-static float CalculateOverlap(float xmin0, float ymin0, float xmax0, float ymax0, float xmin1, float ymin1, float xmax1,
-                              float ymax1)
-{
-    float w = fmax(0.f, fmin(xmax0, xmax1) - fmax(xmin0, xmin1) + 1.0);
-    float h = fmax(0.f, fmin(ymax0, ymax1) - fmax(ymin0, ymin1) + 1.0);
-    float i = w * h;
-    float u = (xmax0 - xmin0 + 1.0) * (ymax0 - ymin0 + 1.0) + (xmax1 - xmin1 + 1.0) * (ymax1 - ymin1 + 1.0) - i;
-    return u <= 0.f ? 0.f : (i / u);
-}
+// Kept boxes of one class during NMS: x1, y1, x2, y2 and area planes of
+// OBJ_NUMB_MAX_SIZE floats each
+#define NMS_PLANES 5
 
-static int nms(int validCount, std::vector<float> &outputLocations, std::vector<int> classIds, std::vector<int> &order,
-               int filterId, float threshold)
+// True if the box overlaps one of the n kept boxes by more than threshold IoU.
+// Corners are inclusive (+1 pixel) as before, the IoU test is done without a
+// division as inter > threshold * union.
+static bool nms_suppressed(float x1, float y1, float x2, float y2, float area, const float *kept, int n,
+                           float threshold)
 {
-    for (int i = 0; i < validCount; ++i)
+    const float *kx1 = kept;
+    const float *ky1 = kept + OBJ_NUMB_MAX_SIZE;
+    const float *kx2 = kept + 2 * OBJ_NUMB_MAX_SIZE;
+    const float *ky2 = kept + 3 * OBJ_NUMB_MAX_SIZE;
+    const float *karea = kept + 4 * OBJ_NUMB_MAX_SIZE;
+    int k = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t one = vdupq_n_f32(1.f);
+    const float32x4_t thr = vdupq_n_f32(threshold);
+    const float32x4_t vx1 = vdupq_n_f32(x1);
+    const float32x4_t vy1 = vdupq_n_f32(y1);
+    const float32x4_t vx2 = vdupq_n_f32(x2);
+    const float32x4_t vy2 = vdupq_n_f32(y2);
+    const float32x4_t varea = vdupq_n_f32(area);
+    for (; k + 4 <= n; k += 4)
     {
-        int n = order[i];
-        if (n == -1 || classIds[n] != filterId)
+        float32x4_t w = vsubq_f32(vminq_f32(vx2, vld1q_f32(kx2 + k)), vmaxq_f32(vx1, vld1q_f32(kx1 + k)));
+        float32x4_t h = vsubq_f32(vminq_f32(vy2, vld1q_f32(ky2 + k)), vmaxq_f32(vy1, vld1q_f32(ky1 + k)));
+        w = vmaxq_f32(zero, vaddq_f32(w, one));
+        h = vmaxq_f32(zero, vaddq_f32(h, one));
+        float32x4_t inter = vmulq_f32(w, h);
+        float32x4_t uni = vsubq_f32(vaddq_f32(varea, vld1q_f32(karea + k)), inter);
+        uint32x4_t hit = vandq_u32(vcgtq_f32(uni, zero), vcgtq_f32(inter, vmulq_f32(thr, uni)));
+        if (vmaxvq_u32(hit) != 0)
         {
-            continue;
+            return true;
         }
-        for (int j = i + 1; j < validCount; ++j)
+    }
+#endif
+    for (; k < n; k++)
+    {
+        float w = fmaxf(0.f, fminf(x2, kx2[k]) - fmaxf(x1, kx1[k]) + 1.f);
+        float h = fmaxf(0.f, fminf(y2, ky2[k]) - fmaxf(y1, ky1[k]) + 1.f);
+        float inter = w * h;
+        float uni = area + karea[k] - inter;
+        if (uni > 0.f && inter > threshold * uni)
         {
-            int m = order[j];
-            if (m == -1 || classIds[m] != filterId)
-            {
-                continue;
-            }
-            float xmin0 = outputLocations[n * 4 + 0];
-            float ymin0 = outputLocations[n * 4 + 1];
-            float xmax0 = outputLocations[n * 4 + 0] + outputLocations[n * 4 + 2];
-            float ymax0 = outputLocations[n * 4 + 1] + outputLocations[n * 4 + 3];
-
-            float xmin1 = outputLocations[m * 4 + 0];
-            float ymin1 = outputLocations[m * 4 + 1];
-            float xmax1 = outputLocations[m * 4 + 0] + outputLocations[m * 4 + 2];
-            float ymax1 = outputLocations[m * 4 + 1] + outputLocations[m * 4 + 3];
-
-            float iou = CalculateOverlap(xmin0, ymin0, xmax0, ymax0, xmin1, ymin1, xmax1, ymax1);
-
-            if (iou > threshold)
-            {
-                order[j] = -1;
-            }
+            return true;
         }
     }
-    return 0;
+    return false;
 }
 
-static int quick_sort_indice_inverse(std::vector<float> &input, int left, int right, std::vector<int> &indices)
+static double get_time_ms()
 {
-    float key;
-    int key_index;
-    int low = left;
-    int high = right;
-    if (left < right)
-    {
-        key_index = indices[left];
-        key = input[left];
-        while (low < high)
-        {
-            while (low < high && input[high] <= key)
-            {
-                high--;
-            }
-            input[low] = input[high];
-            indices[low] = indices[high];
-            while (low < high && input[low] >= key)
-            {
-                low++;
-            }
-            input[high] = input[low];
-            indices[high] = indices[low];
-        }
-        input[low] = key;
-        indices[low] = key_index;
-        quick_sort_indice_inverse(input, left, low - 1, indices);
-        quick_sort_indice_inverse(input, low + 1, right, indices);
-    }
-    return low;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
 }
 
 static float sigmoid(float x) { return 1.0 / (1.0 + expf(-x)); }
@@ -222,10 +209,86 @@ static void compute_dfl(float* tensor, int dfl_len, float* box){
     }
 }
 
+// exp of every dequantized value of an int8 tensor with one zp/scale, index q + 128.
+// Computed like compute_dfl does (double exp of the dequantized float), so the
+// terms are the same and only the summation order differs.
+static void build_dfl_exp_lut(int32_t zp, float scale, float *lut)
+{
+    for (int q = -128; q < 128; q++)
+    {
+        lut[q + 128] = exp(deqnt_affine_to_f32((int8_t)q, zp, scale));
+    }
+}
+
+// compute_dfl on the raw int8 values: one table lookup per term, the softmax
+// expectation sum(e_i * i) / sum(e_i) with a single division per side
+static void compute_dfl_lut(const int8_t *tensor, int dfl_len, const float *lut, float *box)
+{
+    for (int b = 0; b < 4; b++)
+    {
+        const int8_t *side = tensor + b * dfl_len;
+        float exp_sum = 0;
+        float acc_sum = 0;
+        int i = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+        float32x4_t sum4 = vdupq_n_f32(0.f);
+        float32x4_t acc4 = vdupq_n_f32(0.f);
+        const float idx0[4] = {0.f, 1.f, 2.f, 3.f};
+        float32x4_t idx4 = vld1q_f32(idx0);
+        const float32x4_t step4 = vdupq_n_f32(4.f);
+        for (; i + 4 <= dfl_len; i += 4)
+        {
+            float e[4] = {lut[side[i] + 128], lut[side[i + 1] + 128], lut[side[i + 2] + 128], lut[side[i + 3] + 128]};
+            float32x4_t e4 = vld1q_f32(e);
+            sum4 = vaddq_f32(sum4, e4);
+            acc4 = vmlaq_f32(acc4, e4, idx4);
+            idx4 = vaddq_f32(idx4, step4);
+        }
+        exp_sum = vaddvq_f32(sum4);
+        acc_sum = vaddvq_f32(acc4);
+#endif
+        for (; i < dfl_len; i++)
+        {
+            float e = lut[side[i] + 128];
+            exp_sum += e;
+            acc_sum += e * i;
+        }
+        box[b] = acc_sum / exp_sum;
+    }
+}
+
+// Largest difference between compute_dfl_lut and compute_dfl over pseudo random
+// box values, in grid cells. A NaN difference is kept as the result.
+static float check_dfl_exp_lut(int32_t zp, float scale, int dfl_len, const float *lut)
+{
+    uint32_t seed = 12345;
+    float max_err = 0;
+    int8_t q[dfl_len * 4];
+    float before_dfl[dfl_len * 4];
+    for (int n = 0; n < 256; n++)
+    {
+        for (int k = 0; k < dfl_len * 4; k++)
+        {
+            seed = seed * 1103515245 + 12345;
+            q[k] = (int8_t)(seed >> 24);
+            before_dfl[k] = deqnt_affine_to_f32(q[k], zp, scale);
+        }
+        float box_ref[4], box_lut[4];
+        compute_dfl(before_dfl, dfl_len, box_ref);
+        compute_dfl_lut(q, dfl_len, lut, box_lut);
+        for (int b = 0; b < 4; b++)
+        {
+            float err = fabsf(box_ref[b] - box_lut[b]);
+            max_err = (err > max_err || std::isnan(err)) ? err : max_err;
+        }
+    }
+    return max_err;
+}
+
 static int process_u8(uint8_t *box_tensor, int32_t box_zp, float box_scale,
                       uint8_t *score_tensor, int32_t score_zp, float score_scale,
                       uint8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-                      int grid_h, int grid_w, int stride, int dfl_len,
+                      int grid_h, int grid_w, int stride_x, int stride_y, int dfl_len,
                       std::vector<float> &boxes,
                       std::vector<float> &objProbs,
                       std::vector<int> &classId,
@@ -277,10 +340,10 @@ static int process_u8(uint8_t *box_tensor, int32_t box_zp, float box_scale,
                 compute_dfl(before_dfl, dfl_len, box);
 
                 float x1, y1, x2, y2, w, h;
-                x1 = (-box[0] + j + 0.5) * stride;
-                y1 = (-box[1] + i + 0.5) * stride;
-                x2 = (box[2] + j + 0.5) * stride;
-                y2 = (box[3] + i + 0.5) * stride;
+                x1 = (-box[0] + j + 0.5) * stride_x;
+                y1 = (-box[1] + i + 0.5) * stride_y;
+                x2 = (box[2] + j + 0.5) * stride_x;
+                y2 = (box[3] + i + 0.5) * stride_y;
                 w = x2 - x1;
                 h = y2 - y1;
                 boxes.push_back(x1);
@@ -297,10 +360,47 @@ static int process_u8(uint8_t *box_tensor, int32_t box_zp, float box_scale,
     return validCount;
 }
 
-static int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale,
+// cells per block of the class argmax, the block's max and class arrays stay in L1
+#define ARGMAX_BLOCK 512
+
+// Class argmax of the cells [start, start + n), one class plane at a time so every
+// read is contiguous. max_score starts at init and a class only wins when strictly
+// above the current maximum, so the first of equal scores is kept; max_class stays
+// 0xff for cells where no class beat init.
+static void argmax_planes_i8(const int8_t *score_tensor, int grid_len, int start, int n, int8_t init,
+                             int8_t *max_score, uint8_t *max_class)
+{
+    memset(max_score, init, n);
+    memset(max_class, 0xff, n);
+    for (int c = 0; c < OBJ_CLASS_NUM; c++)
+    {
+        const int8_t *plane = score_tensor + c * grid_len + start;
+        int k = 0;
+#if defined(__ARM_NEON)
+        uint8x16_t cls = vdupq_n_u8((uint8_t)c);
+        for (; k + 16 <= n; k += 16)
+        {
+            int8x16_t s = vld1q_s8(plane + k);
+            int8x16_t m = vld1q_s8(max_score + k);
+            uint8x16_t gt = vcgtq_s8(s, m);
+            vst1q_s8(max_score + k, vmaxq_s8(s, m));
+            vst1q_u8(max_class + k, vbslq_u8(gt, cls, vld1q_u8(max_class + k)));
+        }
+#endif
+        // branch free so compilers can vectorize it on other targets
+        for (; k < n; k++)
+        {
+            bool gt = plane[k] > max_score[k];
+            max_score[k] = gt ? plane[k] : max_score[k];
+            max_class[k] = gt ? (uint8_t)c : max_class[k];
+        }
+    }
+}
+
+static int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale, const float *box_exp_lut,
                       int8_t *score_tensor, int32_t score_zp, float score_scale,
                       int8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-                      int grid_h, int grid_w, int stride, int dfl_len,
+                      int grid_h, int grid_w, int stride_x, int stride_y, int dfl_len,
                       std::vector<float> &boxes, 
                       std::vector<float> &objProbs, 
                       std::vector<int> &classId, 
@@ -311,12 +411,21 @@ static int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale,
     int8_t score_thres_i8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
     int8_t score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
 
-    for (int i = 0; i < grid_h; i++)
+    // a class has to beat both the threshold and the initial maximum, cells where
+    // none does keep the initial maximum and no class
+    int8_t init_score = -score_zp;
+    int8_t init_max = init_score > score_thres_i8 ? init_score : score_thres_i8;
+    int8_t block_max[ARGMAX_BLOCK];
+    uint8_t block_class[ARGMAX_BLOCK];
+
+    for (int start = 0; start < grid_len; start += ARGMAX_BLOCK)
     {
-        for (int j = 0; j < grid_w; j++)
+        int n = grid_len - start < ARGMAX_BLOCK ? grid_len - start : ARGMAX_BLOCK;
+        argmax_planes_i8(score_tensor, grid_len, start, n, init_max, block_max, block_class);
+
+        for (int k = 0; k < n; k++)
         {
-            int offset = i* grid_w + j;
-            int max_class_id = -1;
+            int offset = start + k;
 
             // 通过 score sum 起到快速过滤的作用
             if (score_sum_tensor != nullptr){
@@ -325,32 +434,39 @@ static int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale,
                 }
             }
 
-            int8_t max_score = -score_zp;
-            for (int c= 0; c< OBJ_CLASS_NUM; c++){
-                if ((score_tensor[offset] > score_thres_i8) && (score_tensor[offset] > max_score))
-                {
-                    max_score = score_tensor[offset];
-                    max_class_id = c;
-                }
-                offset += grid_len;
-            }
+            int max_class_id = block_class[k] == 0xff ? -1 : block_class[k];
+            int8_t max_score = max_class_id >= 0 ? block_max[k] : init_score;
 
             // compute box
             if (max_score> score_thres_i8){
-                offset = i* grid_w + j;
+                int i = offset / grid_w;
+                int j = offset % grid_w;
                 float box[4];
-                float before_dfl[dfl_len*4];
-                for (int k=0; k< dfl_len*4; k++){
-                    before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset], box_zp, box_scale);
-                    offset += grid_len;
+                if (box_exp_lut != nullptr)
+                {
+                    int8_t box_q[dfl_len * 4];
+                    for (int d = 0; d < dfl_len * 4; d++)
+                    {
+                        box_q[d] = box_tensor[offset];
+                        offset += grid_len;
+                    }
+                    compute_dfl_lut(box_q, dfl_len, box_exp_lut, box);
+                }
+                else
+                {
+                    float before_dfl[dfl_len*4];
+                    for (int d=0; d< dfl_len*4; d++){
+                        before_dfl[d] = deqnt_affine_to_f32(box_tensor[offset], box_zp, box_scale);
+                        offset += grid_len;
+                    }
+                    compute_dfl(before_dfl, dfl_len, box);
                 }
-                compute_dfl(before_dfl, dfl_len, box);
 
                 float x1,y1,x2,y2,w,h;
-                x1 = (-box[0] + j + 0.5)*stride;
-                y1 = (-box[1] + i + 0.5)*stride;
-                x2 = (box[2] + j + 0.5)*stride;
-                y2 = (box[3] + i + 0.5)*stride;
+                x1 = (-box[0] + j + 0.5) * stride_x;
+                y1 = (-box[1] + i + 0.5) * stride_y;
+                x2 = (box[2] + j + 0.5) * stride_x;
+                y2 = (box[3] + i + 0.5) * stride_y;
                 w = x2 - x1;
                 h = y2 - y1;
                 boxes.push_back(x1);
@@ -368,7 +484,7 @@ static int process_i8(int8_t *box_tensor, int32_t box_zp, float box_scale,
 }
 
 static int process_fp32(float *box_tensor, float *score_tensor, float *score_sum_tensor, 
-                        int grid_h, int grid_w, int stride, int dfl_len,
+                        int grid_h, int grid_w, int stride_x, int stride_y, int dfl_len,
                         std::vector<float> &boxes, 
                         std::vector<float> &objProbs, 
                         std::vector<int> &classId, 
@@ -412,10 +528,10 @@ static int process_fp32(float *box_tensor, float *score_tensor, float *score_sum
                 compute_dfl(before_dfl, dfl_len, box);
 
                 float x1,y1,x2,y2,w,h;
-                x1 = (-box[0] + j + 0.5)*stride;
-                y1 = (-box[1] + i + 0.5)*stride;
-                x2 = (box[2] + j + 0.5)*stride;
-                y2 = (box[3] + i + 0.5)*stride;
+                x1 = (-box[0] + j + 0.5) * stride_x;
+                y1 = (-box[1] + i + 0.5) * stride_y;
+                x2 = (box[2] + j + 0.5) * stride_x;
+                y2 = (box[3] + i + 0.5) * stride_y;
                 w = x2 - x1;
                 h = y2 - y1;
                 boxes.push_back(x1);
@@ -432,58 +548,275 @@ static int process_fp32(float *box_tensor, float *score_tensor, float *score_sum
     return validCount;
 }
 
+// Element (c, hw) of a [N, C1, H, W, C2] tensor sits at ((c / C2) * H * W + hw) * C2 + c % C2
+inline static int nc1hwc2_offset(int c, int hw, int plane_len, int c2)
+{
+    return ((c / c2) * plane_len + hw) * c2 + c % c2;
+}
 
-#if defined(RV1106_1103)
-static int process_i8_rv1106(int8_t *box_tensor, int32_t box_zp, float box_scale,
-                             int8_t *score_tensor, int32_t score_zp, float score_scale,
-                             int8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
-                             int grid_h, int grid_w, int stride, int dfl_len,
-                             std::vector<float> &boxes,
-                             std::vector<float> &objProbs,
-                             std::vector<int> &classId,
-                             float threshold) {
+// Fused head: the DFL integral and grid decode run in the graph and one output
+// holds cx, cy, w, h (model input pixels) and the class scores of every anchor,
+// channel major [1, 4+C, N] or anchor major [1, N, 4+C]. Returns the anchor
+// count and the layout as NC1HWC2 parameters (C2 = 1 or 4+C), 0 if the plain
+// attr is not a fused head.
+static int get_plain_fused_layout(const rknn_tensor_attr *attr, int *plane_len, int *c2)
+{
+    const int n_ch = 4 + OBJ_CLASS_NUM;
+    // the two non unit dims, outermost first
+    int d[2];
+    int n = 0;
+    for (uint32_t k = 0; k < attr->n_dims; k++)
+    {
+#ifdef RKNPU1
+        uint32_t dim = attr->dims[attr->n_dims - 1 - k];
+#else
+        uint32_t dim = attr->dims[k];
+#endif
+        if (dim > 1)
+        {
+            if (n == 2)
+            {
+                return 0;
+            }
+            d[n++] = dim;
+        }
+    }
+    if (n != 2)
+    {
+        return 0;
+    }
+    if (d[0] == n_ch)
+    {
+        *plane_len = d[1];
+        *c2 = 1;
+        return d[1];
+    }
+    if (d[1] == n_ch)
+    {
+        *plane_len = d[0];
+        *c2 = n_ch;
+        return d[0];
+    }
+    return 0;
+}
+
+// Same for a buffer in the layout of layout_attr (the native attr in zero copy
+// builds). The orientation always comes from the plain attr: an NC1HWC2 buffer
+// is only decoded in place for a channel major head, whose 4+C fields are on
+// the native C axis. An anchor major head has its anchors there, it is bound
+// in its plain layout at init instead (post_process_reads_native).
+static int get_fused_layout(const rknn_tensor_attr *attr, const rknn_tensor_attr *layout_attr, int *plane_len, int *c2)
+{
+    if (layout_attr->fmt != RKNN_TENSOR_NC1HWC2)
+    {
+        return get_plain_fused_layout(layout_attr, plane_len, c2);
+    }
+
+    int plain_plane, plain_c2;
+    int n_anchor = get_plain_fused_layout(attr, &plain_plane, &plain_c2);
+    if (n_anchor <= 0 || plain_c2 != 1 || layout_attr->n_dims != 5 ||
+        (int)(layout_attr->dims[1] * layout_attr->dims[4]) < 4 + OBJ_CLASS_NUM ||
+        (int)(layout_attr->dims[2] * layout_attr->dims[3]) != n_anchor)
+    {
+        return 0;
+    }
+    *plane_len = n_anchor;
+    *c2 = layout_attr->dims[4];
+    return n_anchor;
+}
+
+inline static void push_fused_box(float cx, float cy, float w, float h, std::vector<float> &boxes)
+{
+    boxes.push_back(cx - w * 0.5f);
+    boxes.push_back(cy - h * 0.5f);
+    boxes.push_back(w);
+    boxes.push_back(h);
+}
+
+static int process_fused_i8(int8_t *tensor, int32_t zp, float scale, int n_anchor, int plane_len, int c2,
+                            std::vector<float> &boxes,
+                            std::vector<float> &objProbs,
+                            std::vector<int> &classId,
+                            float threshold)
+{
     int validCount = 0;
-    int grid_len = grid_h * grid_w;
+    int8_t score_thres_i8 = qnt_f32_to_affine(threshold, zp, scale);
+
+    for (int a = 0; a < n_anchor; a++)
+    {
+        int max_class_id = -1;
+        int8_t max_score = score_thres_i8;
+        for (int c = 0; c < OBJ_CLASS_NUM; c++)
+        {
+            int8_t score = tensor[nc1hwc2_offset(4 + c, a, plane_len, c2)];
+            if (score > max_score)
+            {
+                max_score = score;
+                max_class_id = c;
+            }
+        }
+
+        if (max_score > score_thres_i8)
+        {
+            float xywh[4];
+            for (int k = 0; k < 4; k++)
+            {
+                xywh[k] = deqnt_affine_to_f32(tensor[nc1hwc2_offset(k, a, plane_len, c2)], zp, scale);
+            }
+            push_fused_box(xywh[0], xywh[1], xywh[2], xywh[3], boxes);
+            objProbs.push_back(deqnt_affine_to_f32(max_score, zp, scale));
+            classId.push_back(max_class_id);
+            validCount++;
+        }
+    }
+    return validCount;
+}
+
+static int process_fused_fp32(float *tensor, int n_anchor, int plane_len, int c2,
+                              std::vector<float> &boxes,
+                              std::vector<float> &objProbs,
+                              std::vector<int> &classId,
+                              float threshold)
+{
+    int validCount = 0;
+    for (int a = 0; a < n_anchor; a++)
+    {
+        int max_class_id = -1;
+        float max_score = 0;
+        for (int c = 0; c < OBJ_CLASS_NUM; c++)
+        {
+            float score = tensor[nc1hwc2_offset(4 + c, a, plane_len, c2)];
+            if ((score > threshold) && (score > max_score))
+            {
+                max_score = score;
+                max_class_id = c;
+            }
+        }
+
+        if (max_score > threshold)
+        {
+            push_fused_box(tensor[nc1hwc2_offset(0, a, plane_len, c2)], tensor[nc1hwc2_offset(1, a, plane_len, c2)],
+                           tensor[nc1hwc2_offset(2, a, plane_len, c2)], tensor[nc1hwc2_offset(3, a, plane_len, c2)], boxes);
+            objProbs.push_back(max_score);
+            classId.push_back(max_class_id);
+            validCount++;
+        }
+    }
+    return validCount;
+}
+
+
+#if defined(USE_RGA)
+// NCHW and NHWC are addressed as NC1HWC2 with C2 = 1 and C2 = C
+static void get_native_layout(const rknn_tensor_attr *attr, int *plane_len, int *c2)
+{
+    if (attr->fmt == RKNN_TENSOR_NC1HWC2)
+    {
+        *plane_len = attr->dims[2] * attr->dims[3];
+        *c2 = attr->dims[4];
+    }
+    else if (attr->fmt == RKNN_TENSOR_NHWC)
+    {
+        *plane_len = attr->dims[1] * attr->dims[2];
+        *c2 = attr->dims[3];
+    }
+    else
+    {
+        *plane_len = attr->dims[2] * attr->dims[3];
+        *c2 = 1;
+    }
+}
+
+// Same as process_i8 but reads the NPU native NC1HWC2 output in place, so the
+// tensors never need to be transposed to NCHW. Each tensor is addressed in its
+// own native layout, a branch may mix NC1HWC2 and NCHW outputs.
+static int process_i8_nc1hwc2(int8_t *box_tensor, rknn_tensor_attr *box_attr, const float *box_exp_lut,
+                              int8_t *score_tensor, rknn_tensor_attr *score_attr,
+                              int8_t *score_sum_tensor, rknn_tensor_attr *score_sum_attr,
+                              int grid_h, int grid_w, int stride_x, int stride_y, int dfl_len,
+                              std::vector<float> &boxes,
+                              std::vector<float> &objProbs,
+                              std::vector<int> &classId,
+                              float threshold)
+{
+    int validCount = 0;
+    int32_t box_zp = box_attr->zp;
+    float box_scale = box_attr->scale;
+    int32_t score_zp = score_attr->zp;
+    float score_scale = score_attr->scale;
+    int box_plane, box_c2, score_plane, score_c2;
+    get_native_layout(box_attr, &box_plane, &box_c2);
+    get_native_layout(score_attr, &score_plane, &score_c2);
     int8_t score_thres_i8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
-    int8_t score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
+    int8_t score_sum_thres_i8 = 0;
+    int score_sum_plane = 0, score_sum_c2 = 1;
+    if (score_sum_tensor != nullptr)
+    {
+        score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_attr->zp, score_sum_attr->scale);
+        get_native_layout(score_sum_attr, &score_sum_plane, &score_sum_c2);
+    }
 
-    for (int i = 0; i < grid_h; i++) {
-        for (int j = 0; j < grid_w; j++) {
-            int offset = i * grid_w + j;
+    for (int i = 0; i < grid_h; i++)
+    {
+        for (int j = 0; j < grid_w; j++)
+        {
+            int cell = i * grid_w + j;
             int max_class_id = -1;
 
-            // 通过 score sum 起到快速过滤的作用
-            if (score_sum_tensor != nullptr) {
-                //score_sum_tensor [1, 1, 80, 80]
-                if (score_sum_tensor[offset] < score_sum_thres_i8) {
+            // 通过 score sum 起到快速过滤的作用, score sum has a single channel
+            if (score_sum_tensor != nullptr)
+            {
+                if (score_sum_tensor[cell * score_sum_c2] < score_sum_thres_i8)
+                {
                     continue;
                 }
             }
 
+            // the classes of one cell are contiguous in groups of C2
             int8_t max_score = -score_zp;
-            offset = offset * OBJ_CLASS_NUM;
-            for (int c = 0; c < OBJ_CLASS_NUM; c++) {
-                if ((score_tensor[offset + c] > score_thres_i8) && (score_tensor[offset + c] > max_score)) {
-                    max_score = score_tensor[offset + c]; //80类 [1, 80, 80, 80] 3588NCHW 1106NHWC
-                    max_class_id = c;
+            for (int c1 = 0; c1 * score_c2 < OBJ_CLASS_NUM; c1++)
+            {
+                const int8_t *group = score_tensor + (c1 * score_plane + cell) * score_c2;
+                int n = OBJ_CLASS_NUM - c1 * score_c2 < score_c2 ? OBJ_CLASS_NUM - c1 * score_c2 : score_c2;
+                for (int k = 0; k < n; k++)
+                {
+                    if ((group[k] > score_thres_i8) && (group[k] > max_score))
+                    {
+                        max_score = group[k];
+                        max_class_id = c1 * score_c2 + k;
+                    }
                 }
             }
 
-            // compute box
-            if (max_score > score_thres_i8) {
-                offset = (i * grid_w + j) * 4 * dfl_len;
+            // compute box, only for the cells that passed the threshold
+            if (max_score > score_thres_i8)
+            {
                 float box[4];
-                float before_dfl[dfl_len*4];
-                for (int k=0; k< dfl_len*4; k++){
-                    before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset + k], box_zp, box_scale);
+                if (box_exp_lut != nullptr)
+                {
+                    int8_t box_q[dfl_len * 4];
+                    for (int k = 0; k < dfl_len * 4; k++)
+                    {
+                        box_q[k] = box_tensor[nc1hwc2_offset(k, cell, box_plane, box_c2)];
+                    }
+                    compute_dfl_lut(box_q, dfl_len, box_exp_lut, box);
+                }
+                else
+                {
+                    float before_dfl[dfl_len * 4];
+                    for (int k = 0; k < dfl_len * 4; k++)
+                    {
+                        int8_t q = box_tensor[nc1hwc2_offset(k, cell, box_plane, box_c2)];
+                        before_dfl[k] = deqnt_affine_to_f32(q, box_zp, box_scale);
+                    }
+                    compute_dfl(before_dfl, dfl_len, box);
                 }
-                compute_dfl(before_dfl, dfl_len, box);
 
                 float x1, y1, x2, y2, w, h;
-                x1 = (-box[0] + j + 0.5) * stride;
-                y1 = (-box[1] + i + 0.5) * stride;
-                x2 = (box[2] + j + 0.5) * stride;
-                y2 = (box[3] + i + 0.5) * stride;
+                x1 = (-box[0] + j + 0.5) * stride_x;
+                y1 = (-box[1] + i + 0.5) * stride_y;
+                x2 = (box[2] + j + 0.5) * stride_x;
+                y2 = (box[3] + i + 0.5) * stride_y;
                 w = x2 - x1;
                 h = y2 - y1;
                 boxes.push_back(x1);
@@ -493,75 +826,637 @@ static int process_i8_rv1106(int8_t *box_tensor, int32_t box_zp, float box_scale
 
                 objProbs.push_back(deqnt_affine_to_f32(max_score, score_zp, score_scale));
                 classId.push_back(max_class_id);
-                validCount ++;
+                validCount++;
             }
         }
     }
-    printf("validCount=%d\n", validCount);
-    printf("grid h-%d, w-%d, stride %d\n", grid_h, grid_w, stride);
     return validCount;
 }
-#endif
 
-int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter_box, float conf_threshold, float nms_threshold, object_detect_result_list *od_results)
+// IEEE half precision to float, fp16 is the native output type of non
+// quantized and hybrid quantized models
+inline static float half_to_float(uint16_t h)
 {
-#if defined(RV1106_1103) 
-    rknn_tensor_mem **_outputs = (rknn_tensor_mem **)outputs;
-#else
-    rknn_output *_outputs = (rknn_output *)outputs;
-#endif
-    std::vector<float> filterBoxes;
-    std::vector<float> objProbs;
-    std::vector<int> classId;
-    int validCount = 0;
-    int stride = 0;
-    int grid_h = 0;
-    int grid_w = 0;
-    int model_in_w = app_ctx->model_width;
-    int model_in_h = app_ctx->model_height;
-
-    memset(od_results, 0, sizeof(object_detect_result_list));
-
-    // default 3 branch
-#ifdef RKNPU1
-    int dfl_len = app_ctx->output_attrs[0].dims[2] / 4;
-#else
-    int dfl_len = app_ctx->output_attrs[0].dims[1] /4;
-#endif
-    int output_per_branch = app_ctx->io_num.n_output / 3;
-    for (int i = 0; i < 3; i++)
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+    if (exp == 0x1f)
     {
-#if defined(RV1106_1103)
-        dfl_len = app_ctx->output_attrs[0].dims[3] /4;
-        void *score_sum = nullptr;
-        int32_t score_sum_zp = 0;
-        float score_sum_scale = 1.0;
-        if (output_per_branch == 3) {
-            score_sum = _outputs[i * output_per_branch + 2]->virt_addr;
-            score_sum_zp = app_ctx->output_attrs[i * output_per_branch + 2].zp;
-            score_sum_scale = app_ctx->output_attrs[i * output_per_branch + 2].scale;
-        }
-        int box_idx = i * output_per_branch;
-        int score_idx = i * output_per_branch + 1;
-        grid_h = app_ctx->output_attrs[box_idx].dims[1];
-        grid_w = app_ctx->output_attrs[box_idx].dims[2];
-        stride = model_in_h / grid_h;
-        
-        if (app_ctx->is_quant) {
-            validCount += process_i8_rv1106((int8_t *)_outputs[box_idx]->virt_addr, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale,
-                                (int8_t *)_outputs[score_idx]->virt_addr, app_ctx->output_attrs[score_idx].zp,
-                                app_ctx->output_attrs[score_idx].scale, (int8_t *)score_sum, score_sum_zp, score_sum_scale,
-                                grid_h, grid_w, stride, dfl_len, filterBoxes, objProbs, classId, conf_threshold);
-        }
-        else
+        bits = sign | 0x7f800000 | (mant << 13);
+    }
+    else if (exp != 0)
+    {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    else if (mant == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        // subnormal, normalize the mantissa
+        exp = 113;
+        while ((mant & 0x400) == 0)
         {
-            printf("RV1106/1103 only support quantization mode\n", LABEL_NALE_TXT_PATH);
-            return -1;
+            mant <<= 1;
+            exp--;
         }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
 
-#else
-        void *score_sum = nullptr;
-        int32_t score_sum_zp = 0;
+static void half_to_float_n(const uint16_t *src, float *dst, int n)
+{
+    int i = 0;
+#if defined(__ARM_NEON) && (defined(__aarch64__) || (defined(__ARM_FP) && (__ARM_FP & 2)))
+    for (; i + 4 <= n; i += 4)
+    {
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        dst[i] = half_to_float(src[i]);
+    }
+}
+
+// Load channels [0, n_ch) of one cell as float, a C2 group at a time,
+// fp16 tensors are converted and fp32 tensors copied
+static void load_channels_float(const void *tensor, rknn_tensor_type type, int n_ch, int cell, int plane_len, int c2,
+                                float *dst)
+{
+    for (int c = 0; c < n_ch; c += c2)
+    {
+        int n = n_ch - c < c2 ? n_ch - c : c2;
+        size_t offset = nc1hwc2_offset(c, cell, plane_len, c2);
+        if (type == RKNN_TENSOR_FLOAT16)
+        {
+            half_to_float_n((const uint16_t *)tensor + offset, dst + c, n);
+        }
+        else
+        {
+            memcpy(dst + c, (const float *)tensor + offset, n * sizeof(float));
+        }
+    }
+}
+
+// Same as process_fp32 but reads the fp16/fp32 outputs in place in their native
+// layout, only the channels of the cells being decoded are loaded
+static int process_float_native(void *box_tensor, rknn_tensor_attr *box_attr,
+                                void *score_tensor, rknn_tensor_attr *score_attr,
+                                void *score_sum_tensor, rknn_tensor_attr *score_sum_attr,
+                                int grid_h, int grid_w, int stride_x, int stride_y, int dfl_len,
+                                std::vector<float> &boxes,
+                                std::vector<float> &objProbs,
+                                std::vector<int> &classId,
+                                float threshold)
+{
+    int validCount = 0;
+    int box_plane, box_c2, score_plane, score_c2;
+    int score_sum_plane = 0, score_sum_c2 = 1;
+    get_native_layout(box_attr, &box_plane, &box_c2);
+    get_native_layout(score_attr, &score_plane, &score_c2);
+    if (score_sum_tensor != nullptr)
+    {
+        get_native_layout(score_sum_attr, &score_sum_plane, &score_sum_c2);
+    }
+
+    float scores[OBJ_CLASS_NUM];
+    for (int i = 0; i < grid_h; i++)
+    {
+        for (int j = 0; j < grid_w; j++)
+        {
+            int cell = i * grid_w + j;
+            int max_class_id = -1;
+
+            // 通过 score sum 起到快速过滤的作用, score sum has a single channel
+            if (score_sum_tensor != nullptr)
+            {
+                float score_sum;
+                load_channels_float(score_sum_tensor, score_sum_attr->type, 1, cell, score_sum_plane, score_sum_c2,
+                                    &score_sum);
+                if (score_sum < threshold)
+                {
+                    continue;
+                }
+            }
+
+            load_channels_float(score_tensor, score_attr->type, OBJ_CLASS_NUM, cell, score_plane, score_c2, scores);
+            float max_score = 0;
+            for (int c = 0; c < OBJ_CLASS_NUM; c++)
+            {
+                if ((scores[c] > threshold) && (scores[c] > max_score))
+                {
+                    max_score = scores[c];
+                    max_class_id = c;
+                }
+            }
+
+            // compute box
+            if (max_score > threshold)
+            {
+                float box[4];
+                float before_dfl[dfl_len * 4];
+                load_channels_float(box_tensor, box_attr->type, dfl_len * 4, cell, box_plane, box_c2, before_dfl);
+                compute_dfl(before_dfl, dfl_len, box);
+
+                float x1, y1, x2, y2, w, h;
+                x1 = (-box[0] + j + 0.5) * stride_x;
+                y1 = (-box[1] + i + 0.5) * stride_y;
+                x2 = (box[2] + j + 0.5) * stride_x;
+                y2 = (box[3] + i + 0.5) * stride_y;
+                w = x2 - x1;
+                h = y2 - y1;
+                boxes.push_back(x1);
+                boxes.push_back(y1);
+                boxes.push_back(w);
+                boxes.push_back(h);
+
+                objProbs.push_back(max_score);
+                classId.push_back(max_class_id);
+                validCount++;
+            }
+        }
+    }
+    return validCount;
+}
+static int process_fused_fp16(uint16_t *tensor, int n_anchor, int plane_len, int c2,
+                              std::vector<float> &boxes,
+                              std::vector<float> &objProbs,
+                              std::vector<int> &classId,
+                              float threshold)
+{
+    int validCount = 0;
+    for (int a = 0; a < n_anchor; a++)
+    {
+        int max_class_id = -1;
+        float max_score = 0;
+        for (int c = 0; c < OBJ_CLASS_NUM; c++)
+        {
+            float score = half_to_float(tensor[nc1hwc2_offset(4 + c, a, plane_len, c2)]);
+            if ((score > threshold) && (score > max_score))
+            {
+                max_score = score;
+                max_class_id = c;
+            }
+        }
+
+        if (max_score > threshold)
+        {
+            float xywh[4];
+            for (int k = 0; k < 4; k++)
+            {
+                xywh[k] = half_to_float(tensor[nc1hwc2_offset(k, a, plane_len, c2)]);
+            }
+            push_fused_box(xywh[0], xywh[1], xywh[2], xywh[3], boxes);
+            objProbs.push_back(max_score);
+            classId.push_back(max_class_id);
+            validCount++;
+        }
+    }
+    return validCount;
+}
+#endif
+
+#if defined(RV1106_1103)
+static int process_i8_rv1106(int8_t *box_tensor, int32_t box_zp, float box_scale, const float *box_exp_lut,
+                             int8_t *score_tensor, int32_t score_zp, float score_scale,
+                             int8_t *score_sum_tensor, int32_t score_sum_zp, float score_sum_scale,
+                             int grid_h, int grid_w, int stride_x, int stride_y, int dfl_len,
+                             std::vector<float> &boxes,
+                             std::vector<float> &objProbs,
+                             std::vector<int> &classId,
+                             float threshold) {
+    int validCount = 0;
+    int grid_len = grid_h * grid_w;
+    int8_t score_thres_i8 = qnt_f32_to_affine(threshold, score_zp, score_scale);
+    int8_t score_sum_thres_i8 = qnt_f32_to_affine(threshold, score_sum_zp, score_sum_scale);
+
+    for (int i = 0; i < grid_h; i++) {
+        for (int j = 0; j < grid_w; j++) {
+            int offset = i * grid_w + j;
+            int max_class_id = -1;
+
+            // 通过 score sum 起到快速过滤的作用
+            if (score_sum_tensor != nullptr) {
+                //score_sum_tensor [1, 1, 80, 80]
+                if (score_sum_tensor[offset] < score_sum_thres_i8) {
+                    continue;
+                }
+            }
+
+            int8_t max_score = -score_zp;
+            offset = offset * OBJ_CLASS_NUM;
+            for (int c = 0; c < OBJ_CLASS_NUM; c++) {
+                if ((score_tensor[offset + c] > score_thres_i8) && (score_tensor[offset + c] > max_score)) {
+                    max_score = score_tensor[offset + c]; //80类 [1, 80, 80, 80] 3588NCHW 1106NHWC
+                    max_class_id = c;
+                }
+            }
+
+            // compute box
+            if (max_score > score_thres_i8) {
+                offset = (i * grid_w + j) * 4 * dfl_len;
+                float box[4];
+                if (box_exp_lut != nullptr) {
+                    // NHWC, the box values of a cell are already contiguous
+                    compute_dfl_lut(box_tensor + offset, dfl_len, box_exp_lut, box);
+                } else {
+                    float before_dfl[dfl_len*4];
+                    for (int k=0; k< dfl_len*4; k++){
+                        before_dfl[k] = deqnt_affine_to_f32(box_tensor[offset + k], box_zp, box_scale);
+                    }
+                    compute_dfl(before_dfl, dfl_len, box);
+                }
+
+                float x1, y1, x2, y2, w, h;
+                x1 = (-box[0] + j + 0.5) * stride_x;
+                y1 = (-box[1] + i + 0.5) * stride_y;
+                x2 = (box[2] + j + 0.5) * stride_x;
+                y2 = (box[3] + i + 0.5) * stride_y;
+                w = x2 - x1;
+                h = y2 - y1;
+                boxes.push_back(x1);
+                boxes.push_back(y1);
+                boxes.push_back(w);
+                boxes.push_back(h);
+
+                objProbs.push_back(deqnt_affine_to_f32(max_score, score_zp, score_scale));
+                classId.push_back(max_class_id);
+                validCount ++;
+            }
+        }
+    }
+    printf("validCount=%d\n", validCount);
+    printf("grid h-%d, w-%d, stride %dx%d\n", grid_h, grid_w, stride_x, stride_y);
+    return validCount;
+}
+#endif
+
+// Sort candidate indices by descending score, equal scores keep the candidate
+// order. Quantized scores are dequantized int8 levels, so a counting sort over
+// the 256 levels orders them in O(n) whatever the number of ties. Returns false
+// when a score is not a level of zp/scale, the caller then sorts the floats.
+static bool sort_candidates_quant(std::vector<float> &probs, std::vector<int> &indices, int validCount, int32_t zp,
+                                  float scale, std::vector<uint8_t> &keys)
+{
+    int count[256];
+    memset(count, 0, sizeof(count));
+    keys.resize(validCount);
+    for (int i = 0; i < validCount; i++)
+    {
+        int q = (int)roundf(probs[i] / scale) + zp;
+        if (q < -128 || q > 127 || deqnt_affine_to_f32((int8_t)q, zp, scale) != probs[i])
+        {
+            return false;
+        }
+        keys[i] = (uint8_t)(q + 128);
+        count[q + 128]++;
+    }
+
+    // first slot of every level, highest level first
+    int start[256];
+    int pos = 0;
+    for (int k = 255; k >= 0; k--)
+    {
+        start[k] = pos;
+        pos += count[k];
+    }
+    indices.resize(validCount);
+    for (int i = 0; i < validCount; i++)
+    {
+        indices[start[keys[i]]++] = i;
+    }
+    pos = 0;
+    for (int k = 255; k >= 0; k--)
+    {
+        float prob = deqnt_affine_to_f32((int8_t)(k - 128), zp, scale);
+        for (int c = 0; c < count[k]; c++)
+        {
+            probs[pos++] = prob;
+        }
+    }
+    return true;
+}
+
+// Same order for float scores, std::sort (introsort) keeps the worst case at O(n log n)
+static void sort_candidates_float(std::vector<float> &probs, std::vector<int> &indices, int validCount,
+                                  std::vector<float> &sorted)
+{
+    indices.resize(validCount);
+    for (int i = 0; i < validCount; i++)
+    {
+        indices[i] = i;
+    }
+    const float *p = probs.data();
+    std::sort(indices.begin(), indices.begin() + validCount,
+              [p](int a, int b) { return p[a] > p[b] || (p[a] == p[b] && a < b); });
+    sorted.resize(validCount);
+    for (int i = 0; i < validCount; i++)
+    {
+        sorted[i] = p[indices[i]];
+    }
+    memcpy(probs.data(), sorted.data(), validCount * sizeof(float));
+}
+
+static void sort_candidates(std::vector<float> &probs, int validCount, post_process_scratch_t *scratch)
+{
+    if (scratch->quantSort &&
+        sort_candidates_quant(probs, scratch->indexArray, validCount, scratch->scoreZp, scratch->scoreScale,
+                              scratch->sortKeys))
+    {
+        return;
+    }
+    sort_candidates_float(probs, scratch->indexArray, validCount, scratch->sortProbs);
+}
+
+// Sort, NMS and map the candidates back to the source image. probs is sorted in
+// place along with indexArray, boxes and class ids are left untouched.
+static void collect_results(std::vector<float> &filterBoxes, std::vector<float> &probs, std::vector<int> &classId,
+                            post_process_scratch_t *scratch, int validCount, int model_in_w, int model_in_h,
+                            letterbox_t *letter_box, float nms_threshold, object_detect_result_list *od_results)
+{
+    std::vector<int> &indexArray = scratch->indexArray;
+    od_results->count = 0;
+    indexArray.clear();
+    // no object detect
+    if (validCount <= 0)
+    {
+        return;
+    }
+    sort_candidates(probs, validCount, scratch);
+
+    // one pass in score order: a candidate is kept unless a kept box of the same
+    // class overlaps it, and the pass stops once the result list is full
+    size_t kept_size = OBJ_CLASS_NUM * NMS_PLANES * OBJ_NUMB_MAX_SIZE;
+    if (scratch->nmsKept.size() < kept_size)
+    {
+        scratch->nmsKept.resize(kept_size);
+    }
+    int n_kept[OBJ_CLASS_NUM];
+    memset(n_kept, 0, sizeof(n_kept));
+
+    int last_count = 0;
+
+    // clip to the resized image, not the padded model input, so boxes never
+    // extend into the letterbox bands
+    int content_w = letter_box->content_w > 0 ? letter_box->content_w : model_in_w;
+    int content_h = letter_box->content_h > 0 ? letter_box->content_h : model_in_h;
+
+    /* box valid detect target */
+    for (int i = 0; i < validCount && last_count < OBJ_NUMB_MAX_SIZE; ++i)
+    {
+        int n = indexArray[i];
+        int id = classId[n];
+        // ids outside the label set are not suppressed
+        if (id >= 0 && id < OBJ_CLASS_NUM)
+        {
+            float bx1 = filterBoxes[n * 4 + 0];
+            float by1 = filterBoxes[n * 4 + 1];
+            float bx2 = bx1 + filterBoxes[n * 4 + 2];
+            float by2 = by1 + filterBoxes[n * 4 + 3];
+            float area = (bx2 - bx1 + 1.f) * (by2 - by1 + 1.f);
+            float *kept = &scratch->nmsKept[id * NMS_PLANES * OBJ_NUMB_MAX_SIZE];
+            if (nms_suppressed(bx1, by1, bx2, by2, area, kept, n_kept[id], nms_threshold))
+            {
+                continue;
+            }
+            int k = n_kept[id]++;
+            kept[k] = bx1;
+            kept[OBJ_NUMB_MAX_SIZE + k] = by1;
+            kept[2 * OBJ_NUMB_MAX_SIZE + k] = bx2;
+            kept[3 * OBJ_NUMB_MAX_SIZE + k] = by2;
+            kept[4 * OBJ_NUMB_MAX_SIZE + k] = area;
+        }
+
+        float x1 = filterBoxes[n * 4 + 0] - letter_box->x_pad;
+        float y1 = filterBoxes[n * 4 + 1] - letter_box->y_pad;
+        float x2 = x1 + filterBoxes[n * 4 + 2];
+        float y2 = y1 + filterBoxes[n * 4 + 3];
+        float obj_conf = probs[i];
+
+        od_results->results[last_count].box.left = (int)(clamp(x1, 0, content_w) / letter_box->scale);
+        od_results->results[last_count].box.top = (int)(clamp(y1, 0, content_h) / letter_box->scale);
+        od_results->results[last_count].box.right = (int)(clamp(x2, 0, content_w) / letter_box->scale);
+        od_results->results[last_count].box.bottom = (int)(clamp(y2, 0, content_h) / letter_box->scale);
+        od_results->results[last_count].prop = obj_conf;
+        od_results->results[last_count].cls_id = id;
+        last_count++;
+    }
+    od_results->count = last_count;
+}
+
+#if defined(USE_RGA)
+// True if every output of the branch, score sum included, is plain NCHW in
+// memory. Any other native layout goes to the layout aware decoders.
+static bool is_branch_nchw(rknn_app_context_t *app_ctx, int branch)
+{
+    for (int k = 0; k < app_ctx->output_per_branch; k++)
+    {
+        if (app_ctx->output_native_attrs[branch * app_ctx->output_per_branch + k].fmt != RKNN_TENSOR_NCHW)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// process_fp32 reads plain NCHW fp32 tensors, anything else goes to process_float_native
+static bool is_branch_fp32_nchw(rknn_app_context_t *app_ctx, int branch)
+{
+    for (int k = 0; k < app_ctx->output_per_branch; k++)
+    {
+        if (app_ctx->output_native_attrs[branch * app_ctx->output_per_branch + k].type != RKNN_TENSOR_FLOAT32)
+        {
+            return false;
+        }
+    }
+    return is_branch_nchw(app_ctx, branch);
+}
+#endif
+
+#if !defined(RV1106_1103)
+// Decode a single output model, -1 if the output is not a fused head
+static int process_fused_output(rknn_app_context_t *app_ctx, void *buf,
+                                std::vector<float> &boxes,
+                                std::vector<float> &objProbs,
+                                std::vector<int> &classId,
+                                float threshold)
+{
+#if defined(USE_RGA)
+    // zero copy: the buffer is the NPU output memory in native layout
+    rknn_tensor_attr *attr = &app_ctx->output_native_attrs[0];
+#else
+    rknn_tensor_attr *attr = &app_ctx->output_attrs[0];
+#endif
+    int plane_len, c2;
+    int n_anchor = get_fused_layout(&app_ctx->output_attrs[0], attr, &plane_len, &c2);
+    if (n_anchor <= 0)
+    {
+        printf("single output model but not a [1, %d, N] fused head\n", 4 + OBJ_CLASS_NUM);
+        return -1;
+    }
+    // an int8 head too coarse for the scores is bound as float at init
+    bool quant = (attr->type == RKNN_TENSOR_INT8 || attr->type == RKNN_TENSOR_UINT8) &&
+                 !post_process_needs_float(attr, 1);
+    if (quant)
+    {
+        return process_fused_i8((int8_t *)buf, attr->zp, attr->scale, n_anchor, plane_len, c2,
+                                boxes, objProbs, classId, threshold);
+    }
+#if defined(USE_RGA)
+    if (attr->type == RKNN_TENSOR_FLOAT16)
+    {
+        return process_fused_fp16((uint16_t *)buf, n_anchor, plane_len, c2, boxes, objProbs, classId, threshold);
+    }
+#endif
+    return process_fused_fp32((float *)buf, n_anchor, plane_len, c2, boxes, objProbs, classId, threshold);
+}
+#endif
+
+bool post_process_needs_float(const rknn_tensor_attr *attr, uint32_t n_output)
+{
+    if (n_output != 1 || (attr->type != RKNN_TENSOR_INT8 && attr->type != RKNN_TENSOR_UINT8))
+    {
+        return false;
+    }
+    // a fused head quantizes the box coordinates and the scores with one scale,
+    // pixel coordinates leave steps of about 2.5, far above any score threshold
+    return attr->scale > BOX_THRESH * FUSED_MAX_SCORE_STEP;
+}
+
+bool post_process_reads_native(const rknn_tensor_attr *attr, const rknn_tensor_attr *native_attr, uint32_t n_output)
+{
+    if (native_attr->fmt != RKNN_TENSOR_NC1HWC2)
+    {
+        return true;
+    }
+    if (n_output != 1)
+    {
+        // process_i8_nc1hwc2 and process_float_native
+        return native_attr->type == RKNN_TENSOR_INT8 || native_attr->type == RKNN_TENSOR_FLOAT16 ||
+               native_attr->type == RKNN_TENSOR_FLOAT32;
+    }
+    int plane_len, c2;
+    return get_fused_layout(attr, native_attr, &plane_len, &c2) > 0;
+}
+
+int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter_box, float conf_threshold, float nms_threshold, object_detect_result_list *od_results)
+{
+#if defined(RV1106_1103) 
+    rknn_tensor_mem **_outputs = (rknn_tensor_mem **)outputs;
+#else
+    rknn_output *_outputs = (rknn_output *)outputs;
+#endif
+    post_process_scratch_t local_scratch;
+    post_process_scratch_t *scratch = app_ctx->pp_scratch != nullptr ? app_ctx->pp_scratch : &local_scratch;
+    std::vector<float> &filterBoxes = scratch->filterBoxes;
+    std::vector<float> &objProbs = scratch->objProbs;
+    std::vector<int> &classId = scratch->classId;
+    std::vector<int> &indexArray = scratch->indexArray;
+    filterBoxes.clear();
+    objProbs.clear();
+    classId.clear();
+    indexArray.clear();
+    int validCount = 0;
+    int stride_x = 0;
+    int stride_y = 0;
+    int grid_h = 0;
+    int grid_w = 0;
+    int model_in_w = app_ctx->model_width;
+    int model_in_h = app_ctx->model_height;
+
+    double t0 = get_time_ms();
+    memset(od_results, 0, sizeof(object_detect_result_list));
+
+    // branches as found by init_post_process_branches
+#ifdef RKNPU1
+    int dfl_len = app_ctx->output_attrs[0].dims[2] / 4;
+#else
+    int dfl_len = app_ctx->output_attrs[0].dims[1] /4;
+#endif
+    int output_per_branch = app_ctx->output_per_branch;
+#if !defined(RV1106_1103)
+    if (app_ctx->io_num.n_output == 1)
+    {
+        // fused head, the boxes come out of the graph decoded
+        validCount = process_fused_output(app_ctx, _outputs[0].buf, filterBoxes, objProbs, classId, conf_threshold);
+        if (validCount < 0)
+        {
+            return -1;
+        }
+    }
+#endif
+    // progressive mode decodes the coarsest branch first and emits its results
+    bool progressive = app_ctx->progressive_cb != nullptr && app_ctx->n_branch > 1;
+    int branch_order[32];
+    int n_order = 0;
+    if (progressive)
+    {
+        branch_order[n_order++] = app_ctx->coarsest_branch;
+    }
+    for (int i = 0; i < app_ctx->n_branch; i++)
+    {
+        if ((app_ctx->active_branches & (1u << i)) != 0 && !(progressive && i == app_ctx->coarsest_branch))
+        {
+            branch_order[n_order++] = i;
+        }
+    }
+    for (int k = 0; k < n_order; k++)
+    {
+        int i = branch_order[k];
+        if (progressive && k == 1)
+        {
+            // sort a copy of the scores, the finer branches append to objProbs
+            object_detect_result_list preliminary;
+            memset(&preliminary, 0, sizeof(preliminary));
+            std::vector<float> &probs = scratch->preliminaryProbs;
+            probs.assign(objProbs.begin(), objProbs.end());
+            collect_results(filterBoxes, probs, classId, scratch, validCount, model_in_w, model_in_h,
+                            letter_box, nms_threshold, &preliminary);
+            preliminary.preliminary = 1;
+            preliminary.preliminary_ms = (float)(get_time_ms() - t0);
+            od_results->preliminary_ms = preliminary.preliminary_ms;
+            app_ctx->progressive_cb(&preliminary, app_ctx->progressive_user);
+        }
+#if defined(RV1106_1103)
+        dfl_len = app_ctx->output_attrs[0].dims[3] /4;
+        void *score_sum = nullptr;
+        int32_t score_sum_zp = 0;
+        float score_sum_scale = 1.0;
+        if (output_per_branch == 3) {
+            score_sum = _outputs[i * output_per_branch + 2]->virt_addr;
+            score_sum_zp = app_ctx->output_attrs[i * output_per_branch + 2].zp;
+            score_sum_scale = app_ctx->output_attrs[i * output_per_branch + 2].scale;
+        }
+        int box_idx = i * output_per_branch;
+        int score_idx = i * output_per_branch + 1;
+        grid_h = app_ctx->output_attrs[box_idx].dims[1];
+        grid_w = app_ctx->output_attrs[box_idx].dims[2];
+        // non-square inputs (e.g. 640x384) have different strides per axis
+        stride_x = model_in_w / grid_w;
+        stride_y = model_in_h / grid_h;
+        
+        if (app_ctx->is_quant) {
+            const float *box_exp_lut = scratch->dflExpLut.empty() ? nullptr : &scratch->dflExpLut[box_idx * 256];
+            validCount += process_i8_rv1106((int8_t *)_outputs[box_idx]->virt_addr, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale, box_exp_lut,
+                                (int8_t *)_outputs[score_idx]->virt_addr, app_ctx->output_attrs[score_idx].zp,
+                                app_ctx->output_attrs[score_idx].scale, (int8_t *)score_sum, score_sum_zp, score_sum_scale,
+                                grid_h, grid_w, stride_x, stride_y, dfl_len, filterBoxes, objProbs, classId, conf_threshold);
+        }
+        else
+        {
+            printf("RV1106/1103 only support quantization mode\n", LABEL_NALE_TXT_PATH);
+            return -1;
+        }
+
+#else
+        void *score_sum = nullptr;
+        int32_t score_sum_zp = 0;
         float score_sum_scale = 1.0;
         if (output_per_branch == 3){
             score_sum = _outputs[i*output_per_branch + 2].buf;
@@ -578,83 +1473,245 @@ int post_process(rknn_app_context_t *app_ctx, void *outputs, letterbox_t *letter
         grid_h = app_ctx->output_attrs[box_idx].dims[2];
         grid_w = app_ctx->output_attrs[box_idx].dims[3];
 #endif
-        stride = model_in_h / grid_h;
+        stride_x = model_in_w / grid_w;
+        stride_y = model_in_h / grid_h;
 
+#if defined(USE_RGA)
+        if (app_ctx->is_quant && !is_branch_nchw(app_ctx, i))
+        {
+            // zero copy: buffers are the NPU output memory in native layout
+            const float *box_exp_lut = scratch->dflExpLut.empty() ? nullptr : &scratch->dflExpLut[box_idx * 256];
+            rknn_tensor_attr *score_sum_attr = score_sum != nullptr ? &app_ctx->output_native_attrs[score_idx + 1] : nullptr;
+            validCount += process_i8_nc1hwc2((int8_t *)_outputs[box_idx].buf, &app_ctx->output_native_attrs[box_idx], box_exp_lut,
+                                             (int8_t *)_outputs[score_idx].buf, &app_ctx->output_native_attrs[score_idx],
+                                             (int8_t *)score_sum, score_sum_attr,
+                                             grid_h, grid_w, stride_x, stride_y, dfl_len,
+                                             filterBoxes, objProbs, classId, conf_threshold);
+        }
+        else if (!app_ctx->is_quant && !is_branch_fp32_nchw(app_ctx, i))
+        {
+            // zero copy fp16 outputs or fp32 outputs in native layout, loaded per decoded cell
+            rknn_tensor_attr *score_sum_attr = score_sum != nullptr ? &app_ctx->output_native_attrs[score_idx + 1] : nullptr;
+            validCount += process_float_native(_outputs[box_idx].buf, &app_ctx->output_native_attrs[box_idx],
+                                               _outputs[score_idx].buf, &app_ctx->output_native_attrs[score_idx],
+                                               score_sum, score_sum_attr,
+                                               grid_h, grid_w, stride_x, stride_y, dfl_len,
+                                               filterBoxes, objProbs, classId, conf_threshold);
+        }
+        else
+#endif
         if (app_ctx->is_quant)
         {
 #ifdef RKNPU1
             validCount += process_u8((uint8_t *)_outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale,
                                      (uint8_t *)_outputs[score_idx].buf, app_ctx->output_attrs[score_idx].zp, app_ctx->output_attrs[score_idx].scale,
                                      (uint8_t *)score_sum, score_sum_zp, score_sum_scale,
-                                     grid_h, grid_w, stride, dfl_len,
+                                     grid_h, grid_w, stride_x, stride_y, dfl_len,
                                      filterBoxes, objProbs, classId, conf_threshold);
 #else
-            validCount += process_i8((int8_t *)_outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale,
+            const float *box_exp_lut = scratch->dflExpLut.empty() ? nullptr : &scratch->dflExpLut[box_idx * 256];
+            validCount += process_i8((int8_t *)_outputs[box_idx].buf, app_ctx->output_attrs[box_idx].zp, app_ctx->output_attrs[box_idx].scale, box_exp_lut,
                                      (int8_t *)_outputs[score_idx].buf, app_ctx->output_attrs[score_idx].zp, app_ctx->output_attrs[score_idx].scale,
                                      (int8_t *)score_sum, score_sum_zp, score_sum_scale,
-                                     grid_h, grid_w, stride, dfl_len, 
+                                     grid_h, grid_w, stride_x, stride_y, dfl_len, 
                                      filterBoxes, objProbs, classId, conf_threshold);
 #endif
         }
         else
         {
             validCount += process_fp32((float *)_outputs[box_idx].buf, (float *)_outputs[score_idx].buf, (float *)score_sum,
-                                       grid_h, grid_w, stride, dfl_len, 
+                                       grid_h, grid_w, stride_x, stride_y, dfl_len, 
                                        filterBoxes, objProbs, classId, conf_threshold);
         }
 #endif
     }
 
-    // no object detect
-    if (validCount <= 0)
+    collect_results(filterBoxes, objProbs, classId, scratch, validCount, model_in_w, model_in_h, letter_box,
+                    nms_threshold, od_results);
+    od_results->final_ms = (float)(get_time_ms() - t0);
+    if (progressive)
     {
-        return 0;
+        app_ctx->progressive_cb(od_results, app_ctx->progressive_user);
     }
-    std::vector<int> indexArray;
-    for (int i = 0; i < validCount; ++i)
+    return 0;
+}
+
+static int get_output_channels(const rknn_tensor_attr *attr)
+{
+#if defined(RV1106_1103)
+    return attr->dims[3];
+#elif defined(RKNPU1)
+    return attr->dims[2];
+#else
+    return attr->dims[1];
+#endif
+}
+
+static int get_output_grid_w(const rknn_tensor_attr *attr)
+{
+#if defined(RV1106_1103)
+    return attr->dims[2];
+#elif defined(RKNPU1)
+    return attr->dims[0];
+#else
+    return attr->dims[3];
+#endif
+}
+
+int init_post_process_branches(rknn_app_context_t *app_ctx)
+{
+    int n_output = app_ctx->io_num.n_output;
+    app_ctx->n_branch = 0;
+    app_ctx->output_per_branch = 0;
+    app_ctx->active_branches = 0;
+    if (n_output == 1)
     {
-        indexArray.push_back(i);
+        // fused head, nothing to select
+        return 0;
     }
-    quick_sort_indice_inverse(objProbs, 0, validCount - 1, indexArray);
 
-    std::set<int> class_set(std::begin(classId), std::end(classId));
+    // every branch has a box and a score output, plus a single channel score sum
+    int output_per_branch = n_output >= 3 && get_output_channels(&app_ctx->output_attrs[2]) == 1 ? 3 : 2;
+    int n_branch = n_output / output_per_branch;
+    if (n_output % output_per_branch != 0 || n_branch > 32)
+    {
+        printf("unsupported output layout: %d outputs\n", n_output);
+        return -1;
+    }
 
-    for (auto c : class_set)
+    uint32_t all = n_branch == 32 ? 0xffffffffu : (1u << n_branch) - 1;
+    uint32_t active = app_ctx->branch_mask != 0 ? app_ctx->branch_mask & all : all;
+    int coarsest = 0;
+    int max_stride = 0;
+    for (int b = 0; b < n_branch; b++)
     {
-        nms(validCount, filterBoxes, classId, indexArray, c, nms_threshold);
+        int stride = app_ctx->model_width / get_output_grid_w(&app_ctx->output_attrs[b * output_per_branch]);
+        if (stride > max_stride)
+        {
+            max_stride = stride;
+            coarsest = b;
+        }
+        // a branch finds objects up to about 8 cells across
+        if (app_ctx->min_object_size > 0 && stride * 8 < app_ctx->min_object_size)
+        {
+            active &= ~(1u << b);
+        }
     }
+    if (active == 0)
+    {
+        active = 1u << coarsest;
+    }
+    // first branch of the progressive mode, the coarsest one still active
+    max_stride = 0;
+    for (int b = 0; b < n_branch; b++)
+    {
+        int stride = app_ctx->model_width / get_output_grid_w(&app_ctx->output_attrs[b * output_per_branch]);
+        if ((active & (1u << b)) != 0 && stride > max_stride)
+        {
+            max_stride = stride;
+            coarsest = b;
+        }
+    }
+    app_ctx->coarsest_branch = coarsest;
 
-    int last_count = 0;
-    od_results->count = 0;
+    app_ctx->n_branch = n_branch;
+    app_ctx->output_per_branch = output_per_branch;
+    app_ctx->active_branches = active;
+    printf("post process: %d branches, %d outputs each, active mask 0x%x\n", n_branch, output_per_branch, active);
+    return 0;
+}
 
-    /* box valid detect target */
-    for (int i = 0; i < validCount; ++i)
+int init_post_process_scratch(rknn_app_context_t *app_ctx)
+{
+    // every grid cell of every output can become at most one candidate
+    size_t max_candidates = 0;
+    int plane_len, c2;
+    if (app_ctx->io_num.n_output == 1)
+    {
+        // fused head, one candidate per anchor
+        max_candidates = get_plain_fused_layout(&app_ctx->output_attrs[0], &plane_len, &c2);
+    }
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output && max_candidates == 0; i++)
     {
-        if (indexArray[i] == -1 || last_count >= OBJ_NUMB_MAX_SIZE)
+        rknn_tensor_attr *attr = &app_ctx->output_attrs[i];
+        size_t cells = 1;
+        for (uint32_t d = 2; d < attr->n_dims; d++)
         {
-            continue;
+            cells *= attr->dims[d];
         }
-        int n = indexArray[i];
+        max_candidates += cells;
+    }
 
-        float x1 = filterBoxes[n * 4 + 0] - letter_box->x_pad;
-        float y1 = filterBoxes[n * 4 + 1] - letter_box->y_pad;
-        float x2 = x1 + filterBoxes[n * 4 + 2];
-        float y2 = y1 + filterBoxes[n * 4 + 3];
-        int id = classId[n];
-        float obj_conf = objProbs[i];
+    post_process_scratch_t *scratch = new post_process_scratch_t();
+    scratch->filterBoxes.reserve(max_candidates * 4);
+    scratch->objProbs.reserve(max_candidates);
+    scratch->classId.reserve(max_candidates);
+    scratch->indexArray.reserve(max_candidates);
+    scratch->preliminaryProbs.reserve(max_candidates);
+    scratch->sortKeys.reserve(max_candidates);
+    scratch->sortProbs.reserve(max_candidates);
+    scratch->nmsKept.resize(OBJ_CLASS_NUM * NMS_PLANES * OBJ_NUMB_MAX_SIZE);
+
+    // int8 scores that share one quantization are sorted by level
+    if (app_ctx->is_quant)
+    {
+        int n_score = app_ctx->io_num.n_output == 1 ? 1 : app_ctx->n_branch;
+        scratch->quantSort = n_score > 0;
+        for (int b = 0; b < n_score; b++)
+        {
+            int score_idx = app_ctx->io_num.n_output == 1 ? 0 : b * app_ctx->output_per_branch + 1;
+            rknn_tensor_attr *attr = &app_ctx->output_attrs[score_idx];
+            if (b == 0)
+            {
+                scratch->scoreZp = attr->zp;
+                scratch->scoreScale = attr->scale;
+            }
+            if (attr->type != RKNN_TENSOR_INT8 || attr->zp != scratch->scoreZp || attr->scale != scratch->scoreScale)
+            {
+                scratch->quantSort = false;
+            }
+        }
+        printf("post process: %s candidate sort\n", scratch->quantSort ? "counting" : "introsort");
+    }
 
-        od_results->results[last_count].box.left = (int)(clamp(x1, 0, model_in_w) / letter_box->scale);
-        od_results->results[last_count].box.top = (int)(clamp(y1, 0, model_in_h) / letter_box->scale);
-        od_results->results[last_count].box.right = (int)(clamp(x2, 0, model_in_w) / letter_box->scale);
-        od_results->results[last_count].box.bottom = (int)(clamp(y2, 0, model_in_h) / letter_box->scale);
-        od_results->results[last_count].prop = obj_conf;
-        od_results->results[last_count].cls_id = id;
-        last_count++;
+    // dequantize + exp of the DFL bins folded into one table per box output
+    if (app_ctx->is_quant && app_ctx->io_num.n_output > 1)
+    {
+        scratch->dflExpLut.resize(app_ctx->io_num.n_output * 256);
+        float max_err = 0;
+        for (int b = 0; b < app_ctx->n_branch; b++)
+        {
+            int box_idx = b * app_ctx->output_per_branch;
+            rknn_tensor_attr *attr = &app_ctx->output_attrs[box_idx];
+            float *lut = &scratch->dflExpLut[box_idx * 256];
+            build_dfl_exp_lut(attr->zp, attr->scale, lut);
+            float err = check_dfl_exp_lut(attr->zp, attr->scale, get_output_channels(attr) / 4, lut);
+            max_err = (err > max_err || std::isnan(err)) ? err : max_err;
+        }
+        // NaN or inf fail as well
+        if (!(max_err <= DFL_LUT_MAX_ERR))
+        {
+            printf("dfl lut: max error %f exceeds %f, using compute_dfl\n", max_err, DFL_LUT_MAX_ERR);
+            scratch->dflExpLut.clear();
+        }
+        else
+        {
+            printf("dfl lut: max error %g grid cells\n", max_err);
+        }
     }
-    od_results->count = last_count;
+    app_ctx->pp_scratch = scratch;
     return 0;
 }
 
+void release_post_process_scratch(rknn_app_context_t *app_ctx)
+{
+    if (app_ctx->pp_scratch != nullptr)
+    {
+        delete app_ctx->pp_scratch;
+        app_ctx->pp_scratch = nullptr;
+    }
+}
+
 int init_post_process()
 {
     int ret = 0;
@@ -694,3 +1751,62 @@ void deinit_post_process()
         }
     }
 }
+
+int benchmark_post_process_sort(int candidates, int iterations)
+{
+    static const char *names[3] = {"1 level", "8 levels", "256 levels"};
+    static const int levels[3] = {1, 8, 256};
+    // sigmoid scores as exported by the int8 models
+    const int32_t zp = -128;
+    const float scale = 1.0f / 255;
+
+    if (candidates <= 0 || iterations <= 0)
+    {
+        return -1;
+    }
+    post_process_scratch_t scratch;
+    std::vector<float> scores(candidates);
+    std::vector<float> probs(candidates);
+    std::vector<int> counting_order;
+    uint32_t seed = 1;
+
+    for (int d = 0; d < 3; d++)
+    {
+        for (int i = 0; i < candidates; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            int level = 127 - (int)((seed >> 16) % levels[d]);
+            scores[i] = deqnt_affine_to_f32((int8_t)level, zp, scale);
+        }
+
+        double t0 = get_time_ms();
+        for (int it = 0; it < iterations; it++)
+        {
+            probs = scores;
+            sort_candidates_quant(probs, scratch.indexArray, candidates, zp, scale, scratch.sortKeys);
+        }
+        double counting_ms = (get_time_ms() - t0) / iterations;
+        counting_order = scratch.indexArray;
+
+        t0 = get_time_ms();
+        for (int it = 0; it < iterations; it++)
+        {
+            probs = scores;
+            sort_candidates_float(probs, scratch.indexArray, candidates, scratch.sortProbs);
+        }
+        double float_ms = (get_time_ms() - t0) / iterations;
+
+        bool same = counting_order == scratch.indexArray;
+        printf("sort %d candidates, %-10s: counting %.3f ms, introsort %.3f ms, order %s\n", candidates, names[d],
+               counting_ms, float_ms, same ? "identical" : "DIFFERENT");
+        if (!same)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef YOLO11_POST_PROCESS_CHECK
+#include "postprocess_check.inc"
+#endif
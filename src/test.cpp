@@ -16,6 +16,8 @@
 
 #include "image_utils.h"
 #include "yolo11.h"
+#include "yolo11_perf.h"
+#include "yolo11_sched.h"
 #include "postprocess.h"
 #include "dma_alloc.h"
 
@@ -435,7 +437,97 @@ int main(int argc, char **argv)
 
     // 2. 初始化YOLO11模型
     printf("2. 加载YOLO11模型: %s\n", model_path);
-    
+
+    // 模型加载方式，可通过环境变量 YOLO11_MODEL_LOAD=buffered|mmap|zerocopy 对比启动耗时
+    if (getenv("YOLO11_MODEL_LOAD") != NULL)
+    {
+        const char *load_mode = getenv("YOLO11_MODEL_LOAD");
+        if (strcmp(load_mode, "buffered") == 0)
+        {
+            rknn_app_ctx.model_load_mode = MODEL_LOAD_BUFFERED;
+        }
+        else if (strcmp(load_mode, "mmap") == 0)
+        {
+            rknn_app_ctx.model_load_mode = MODEL_LOAD_MMAP;
+        }
+        else if (strcmp(load_mode, "zerocopy") == 0)
+        {
+            rknn_app_ctx.model_load_mode = MODEL_LOAD_ZERO_COPY;
+        }
+    }
+
+    // 逐层性能分析，YOLO11_PERF=report.csv 每 100 帧写一次 CSV 报告
+    if (getenv("YOLO11_PERF") != NULL)
+    {
+        rknn_app_ctx.collect_perf = true;
+        rknn_app_ctx.perf_report_path = getenv("YOLO11_PERF");
+        rknn_app_ctx.perf_report_interval = 100;
+    }
+
+    // 输出内存缓存策略，YOLO11_OUTPUT_CACHE=uncached|cached
+    if (getenv("YOLO11_OUTPUT_CACHE") != NULL)
+    {
+        const char *cache_mode = getenv("YOLO11_OUTPUT_CACHE");
+        if (strcmp(cache_mode, "uncached") == 0)
+        {
+            rknn_app_ctx.output_cache_mode = OUTPUT_CACHE_UNCACHED;
+        }
+        else if (strcmp(cache_mode, "cached") == 0)
+        {
+            rknn_app_ctx.output_cache_mode = OUTPUT_CACHE_CACHED;
+        }
+    }
+
+    // 输入只由RGA写入，跳过输入缓存刷新，YOLO11_DEVICE_INPUT=1
+    if (getenv("YOLO11_DEVICE_INPUT") != NULL && atoi(getenv("YOLO11_DEVICE_INPUT")) != 0)
+    {
+        rknn_app_ctx.device_written_input = true;
+    }
+
+    // 推理优先级，YOLO11_PRIORITY=high|medium|low
+    if (getenv("YOLO11_PRIORITY") != NULL)
+    {
+        const char *priority = getenv("YOLO11_PRIORITY");
+        if (strcmp(priority, "medium") == 0)
+        {
+            rknn_app_ctx.priority = YOLO11_PRIORITY_MEDIUM;
+        }
+        else if (strcmp(priority, "low") == 0)
+        {
+            rknn_app_ctx.priority = YOLO11_PRIORITY_LOW;
+        }
+    }
+
+    // 只解码部分检测分支，YOLO11_BRANCH_MASK=0x6 或 YOLO11_MIN_OBJECT_SIZE=96
+    if (getenv("YOLO11_BRANCH_MASK") != NULL)
+    {
+        rknn_app_ctx.branch_mask = (uint32_t)strtoul(getenv("YOLO11_BRANCH_MASK"), NULL, 0);
+    }
+    if (getenv("YOLO11_MIN_OBJECT_SIZE") != NULL)
+    {
+        rknn_app_ctx.min_object_size = atoi(getenv("YOLO11_MIN_OBJECT_SIZE"));
+    }
+
+    // NPU推理超时（毫秒），YOLO11_RUN_TIMEOUT_MS=500
+    if (getenv("YOLO11_RUN_TIMEOUT_MS") != NULL)
+    {
+        rknn_app_ctx.run_timeout_ms = atoi(getenv("YOLO11_RUN_TIMEOUT_MS"));
+    }
+
+#if defined(ZERO_COPY)
+    // RGA与NPU之间用fence同步，YOLO11_FENCE=1
+    if (getenv("YOLO11_FENCE") != NULL && atoi(getenv("YOLO11_FENCE")) != 0)
+    {
+        rknn_app_ctx.use_fence = true;
+    }
+    // 输入使用DMA缓冲环，YOLO11_INPUT_RING=3
+    if (getenv("YOLO11_INPUT_RING") != NULL)
+    {
+        rknn_app_ctx.input_ring_size = atoi(getenv("YOLO11_INPUT_RING"));
+    }
+#endif
+
+    timer_start(&timer);
     ret = init_yolo11_model(model_path, &rknn_app_ctx);
     if (ret != 0)
     {
@@ -443,7 +535,51 @@ int main(int argc, char **argv)
         goto cleanup;
     }
     model_initialized = true;
-    printf("   模型加载成功，耗时: %.2f ms\n\n", timer_end(&timer));
+    printf("   模型加载成功，耗时: %.2f ms (读取 %.2f ms, rknn_init %.2f ms)\n\n", timer_end(&timer),
+           rknn_app_ctx.model_load_ms, rknn_app_ctx.model_init_ms);
+
+    // 权重共享验证，YOLO11_SHARED_CHECK=1: 创建一个共享权重的从属上下文，
+    // 对比两者的 context mem 输出 (从属上下文的 weight 与 model buffer 应不再占用一份完整权重)
+    if (getenv("YOLO11_SHARED_CHECK") != NULL && atoi(getenv("YOLO11_SHARED_CHECK")) != 0)
+    {
+        rknn_app_context_t sibling_ctx;
+        memset(&sibling_ctx, 0, sizeof(sibling_ctx));
+        printf("   主上下文:\n");
+        dump_yolo11_mem_size(&rknn_app_ctx);
+        printf("   共享权重的从属上下文:\n");
+        if (init_yolo11_model_shared(model_path, &rknn_app_ctx, &sibling_ctx) == 0)
+        {
+            // 从属上下文必须先于主上下文释放
+            release_yolo11_model(&sibling_ctx);
+        }
+    }
+
+#ifdef ZERO_COPY
+    // 输出内存读取耗时对比 (非缓存 vs 缓存+rknn_mem_sync)，YOLO11_BENCH_READS=帧数
+    if (getenv("YOLO11_BENCH_READS") != NULL)
+    {
+        benchmark_yolo11_output_reads(&rknn_app_ctx, atoi(getenv("YOLO11_BENCH_READS")));
+    }
+    // 输入缓存刷新耗时，YOLO11_BENCH_FLUSH=帧数
+    if (getenv("YOLO11_BENCH_FLUSH") != NULL)
+    {
+        benchmark_yolo11_input_flush(&rknn_app_ctx, atoi(getenv("YOLO11_BENCH_FLUSH")));
+    }
+#endif
+
+    // 候选框排序耗时 (计数排序 vs introsort)，YOLO11_BENCH_SORT=候选框数量
+    if (getenv("YOLO11_BENCH_SORT") != NULL)
+    {
+        benchmark_post_process_sort(atoi(getenv("YOLO11_BENCH_SORT")), 100);
+    }
+
+#ifdef YOLO11_POST_PROCESS_CHECK
+    // 后处理优化路径与原始实现的一致性检查，YOLO11_CHECK_POST_PROCESS=随机样本数
+    if (getenv("YOLO11_CHECK_POST_PROCESS") != NULL)
+    {
+        check_post_process(atoi(getenv("YOLO11_CHECK_POST_PROCESS")));
+    }
+#endif
 
     // 3. 初始化摄像头
     printf("3. 初始化摄像头: %s\n", camera_device);
@@ -454,6 +590,14 @@ int main(int argc, char **argv)
         goto cleanup;
     }
     camera_initialized = true;
+
+    // 动态shape模型按摄像头宽高比选择输入尺寸，减少letterbox填充
+    ret = select_yolo11_input_shape(&rknn_app_ctx, cam_width, cam_height);
+    if (ret != 0)
+    {
+        printf("ERROR: 选择输入尺寸失败\n");
+        goto cleanup;
+    }
     printf("\n");
 
     // 4. 分配目标缓冲区 (移到循环外，只分配一次)
@@ -630,8 +774,11 @@ int main(int argc, char **argv)
 #endif
 
 #ifdef ZERO_COPY
-        // 同步到设备
-        dma_sync_cpu_to_device(rknn_app_ctx.img_dma_buf.dma_buf_fd);
+        // 同步到设备，RGA写入的缓冲区CPU缓存中没有数据，无需刷新
+        if (!rknn_app_ctx.device_written_input)
+        {
+            dma_sync_cpu_to_device(rknn_app_ctx.img_dma_buf.dma_buf_fd);
+        }
 #endif
         // 放回缓冲区
         release_frame(&camera, &readbuffer);
@@ -703,6 +850,7 @@ int main(int argc, char **argv)
     //     printf("WARNING: 保存图像失败\n");
     // }
 
+    dump_yolo11_latency_stats();
     printf("\n========== 测试完成 ==========\n\n");
 
 cleanup:
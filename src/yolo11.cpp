@@ -16,9 +16,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include "yolo11.h"
+#include "yolo11_perf.h"
+#include "yolo11_sched.h"
+#include "alloc_debug.h"
 #include "common.h"
+#include "dma_alloc.h"
 #include "file_utils.h"
 #include "image_utils.h"
 
@@ -31,307 +39,1545 @@ static void dump_tensor_attr(rknn_tensor_attr *attr)
            get_qnt_type_string(attr->qnt_type), attr->zp, attr->scale);
 }
 
-int init_yolo11_model(const char *model_path, rknn_app_context_t *app_ctx)
+static double get_time_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static const char *get_model_load_mode_string(model_load_mode_t mode)
+{
+    switch (mode)
+    {
+    case MODEL_LOAD_BUFFERED: return "buffered";
+    case MODEL_LOAD_MMAP: return "mmap";
+    case MODEL_LOAD_ZERO_COPY: return "zero-copy";
+    default: return "auto";
+    }
+}
+
+// Read the model straight into NPU memory and let the runtime use it in place
+static int init_model_zero_copy(const char *model_path, uint32_t flag, rknn_context share_ctx, rknn_app_context_t *app_ctx,
+                                rknn_context *ctx)
 {
     int ret;
-    int model_len = 0;
-    char *model;
-    rknn_context ctx = 0;
+    double t0 = get_time_ms();
 
-    // Load RKNN Model
-    model_len = read_data_from_file(model_path, &model);
-    if (model == NULL)
+    int model_len = get_file_size(model_path);
+    if (model_len <= 0)
     {
-        printf("load_model fail!\n");
         return -1;
     }
+    rknn_tensor_mem *model_mem = rknn_create_mem2(0, model_len, RKNN_MEM_FLAG_ALLOC_NO_CONTEXT);
+    if (model_mem == NULL)
+    {
+        printf("rknn_create_mem2 for model buffer fail!\n");
+        return -1;
+    }
+    ret = read_file_to_buffer(model_path, model_mem->virt_addr, model_len);
+    if (ret != 0)
+    {
+        rknn_destroy_mem(0, model_mem);
+        return -1;
+    }
+    double t1 = get_time_ms();
 
-    ret = rknn_init(&ctx, model, model_len, 0, NULL);
-    free(model);
+    rknn_init_extend init_ext;
+    memset(&init_ext, 0, sizeof(init_ext));
+    init_ext.ctx = share_ctx;
+    init_ext.model_buffer_fd = model_mem->fd;
+    ret = rknn_init(ctx, model_mem->virt_addr, model_len, flag | RKNN_FLAG_MODEL_BUFFER_ZERO_COPY, &init_ext);
     if (ret < 0)
     {
-        printf("rknn_init fail! ret=%d\n", ret);
+        printf("rknn_init with zero copy model buffer fail! ret=%d\n", ret);
+        rknn_destroy_mem(0, model_mem);
         return -1;
     }
+    app_ctx->model_mem = model_mem;
+    app_ctx->model_load_ms = t1 - t0;
+    app_ctx->model_init_ms = get_time_ms() - t1;
+    return 0;
+}
 
-    // Get Model Input Output Number
-    rknn_input_output_num io_num;
-    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
-    if (ret != RKNN_SUCC)
+static int init_model_mmap(const char *model_path, uint32_t flag, rknn_context share_ctx, rknn_app_context_t *app_ctx,
+                           rknn_context *ctx)
+{
+    int ret;
+    void *model = NULL;
+    double t0 = get_time_ms();
+
+    int model_len = mmap_data_from_file(model_path, &model);
+    if (model_len <= 0)
     {
-        printf("rknn_query fail! ret=%d\n", ret);
         return -1;
     }
-    printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
+    double t1 = get_time_ms();
 
-#ifdef USE_RGA
-    // 零拷贝版本：使用native属性，创建内存对象
-    printf("input tensors (native):\n");
-    rknn_tensor_attr input_native_attrs[io_num.n_input];
-    memset(input_native_attrs, 0, sizeof(input_native_attrs));
-    for (int i = 0; i < io_num.n_input; i++)
+    // the runtime copies the model, pages are faulted in while it does
+    rknn_init_extend init_ext;
+    memset(&init_ext, 0, sizeof(init_ext));
+    init_ext.ctx = share_ctx;
+    ret = rknn_init(ctx, model, model_len, flag, share_ctx != 0 ? &init_ext : NULL);
+    unmap_data_from_file(model, model_len);
+    if (ret < 0)
     {
-        input_native_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, &(input_native_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
-        {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
-        dump_tensor_attr(&(input_native_attrs[i]));
+        printf("rknn_init fail! ret=%d\n", ret);
+        return -1;
     }
+    app_ctx->model_load_ms = t1 - t0;
+    app_ctx->model_init_ms = get_time_ms() - t1;
+    return 0;
+}
 
-    // default input type is int8 (normalize and quantize need compute in outside)
-    // if set uint8, will fuse normalize and quantize to npu
-    input_native_attrs[0].type = RKNN_TENSOR_UINT8;
-    app_ctx->input_mems[0] = rknn_create_mem(ctx, input_native_attrs[0].size_with_stride);
+static int init_model_buffered(const char *model_path, uint32_t flag, rknn_context share_ctx, rknn_app_context_t *app_ctx,
+                               rknn_context *ctx)
+{
+    int ret;
+    char *model = NULL;
+    double t0 = get_time_ms();
 
-    // Set input tensor memory
-    ret = rknn_set_io_mem(ctx, app_ctx->input_mems[0], &input_native_attrs[0]);
+    int model_len = read_data_from_file(model_path, &model);
+    if (model_len <= 0 || model == NULL)
+    {
+        printf("load_model fail!\n");
+        return -1;
+    }
+    double t1 = get_time_ms();
+
+    rknn_init_extend init_ext;
+    memset(&init_ext, 0, sizeof(init_ext));
+    init_ext.ctx = share_ctx;
+    ret = rknn_init(ctx, model, model_len, flag, share_ctx != 0 ? &init_ext : NULL);
+    free(model);
     if (ret < 0)
     {
-        printf("input_mems rknn_set_io_mem fail! ret=%d\n", ret);
+        printf("rknn_init fail! ret=%d\n", ret);
         return -1;
     }
+    app_ctx->model_load_ms = t1 - t0;
+    app_ctx->model_init_ms = get_time_ms() - t1;
+    return 0;
+}
 
-    // Get Model Output Info
-    printf("output tensors (native):\n");
-    rknn_tensor_attr output_native_attrs[io_num.n_output];
-    memset(output_native_attrs, 0, sizeof(output_native_attrs));
-    for (int i = 0; i < io_num.n_output; i++)
+// Load the model with the requested mode, AUTO falls back from the fastest
+// path to the plain buffered read
+static int load_yolo11_model(const char *model_path, uint32_t flag, rknn_context share_ctx, rknn_app_context_t *app_ctx,
+                             rknn_context *ctx)
+{
+    model_load_mode_t requested = app_ctx->model_load_mode;
+    model_load_mode_t mode = requested;
+    int ret = -1;
+
+    app_ctx->model_mem = NULL;
+    if (share_ctx != 0 && (requested == MODEL_LOAD_AUTO || requested == MODEL_LOAD_ZERO_COPY))
     {
-        output_native_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_NATIVE_OUTPUT_ATTR, &(output_native_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
+        // a zero copy model buffer would hold a full copy of the weights per
+        // sibling, the shared weights only need a transient mapping of the file
+        if (requested == MODEL_LOAD_ZERO_COPY)
         {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
+            printf("model load: zero-copy is not used for shared weights, using mmap\n");
         }
-        dump_tensor_attr(&(output_native_attrs[i]));
+        requested = MODEL_LOAD_AUTO;
+    }
+    else if (requested == MODEL_LOAD_AUTO || requested == MODEL_LOAD_ZERO_COPY)
+    {
+        ret = init_model_zero_copy(model_path, flag, share_ctx, app_ctx, ctx);
+        mode = MODEL_LOAD_ZERO_COPY;
+    }
+    if (ret != 0 && (requested == MODEL_LOAD_AUTO || requested == MODEL_LOAD_MMAP))
+    {
+        ret = init_model_mmap(model_path, flag, share_ctx, app_ctx, ctx);
+        mode = MODEL_LOAD_MMAP;
+    }
+    if (ret != 0 && (requested == MODEL_LOAD_AUTO || requested == MODEL_LOAD_BUFFERED))
+    {
+        ret = init_model_buffered(model_path, flag, share_ctx, app_ctx, ctx);
+        mode = MODEL_LOAD_BUFFERED;
+    }
+    if (ret != 0)
+    {
+        printf("load model %s with mode %s fail!\n", model_path, get_model_load_mode_string(app_ctx->model_load_mode));
+        return -1;
     }
 
-    // Set output tensor memory
-    for (uint32_t i = 0; i < io_num.n_output; ++i)
+    app_ctx->model_load_mode = mode;
+    printf("model load: mode=%s, read=%.2f ms, rknn_init=%.2f ms, total=%.2f ms\n",
+           get_model_load_mode_string(mode), app_ctx->model_load_ms, app_ctx->model_init_ms,
+           app_ctx->model_load_ms + app_ctx->model_init_ms);
+    return 0;
+}
+
+static uint32_t get_free_sram_size(rknn_context ctx)
+{
+    rknn_mem_size mem_size;
+    memset(&mem_size, 0, sizeof(mem_size));
+    if (rknn_query(ctx, RKNN_QUERY_MEM_SIZE, &mem_size, sizeof(mem_size)) != RKNN_SUCC)
     {
-        app_ctx->output_mems[i] = rknn_create_mem(ctx, output_native_attrs[i].size_with_stride);
-        ret = rknn_set_io_mem(ctx, app_ctx->output_mems[i], &output_native_attrs[i]);
-        if (ret < 0)
-        {
-            printf("output_mems rknn_set_io_mem fail! ret=%d\n", ret);
-            return -1;
-        }
+        return 0;
     }
+    return mem_size.free_sram_size;
+}
 
-    // TODO
-    if (output_native_attrs[0].qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && output_native_attrs[0].type == RKNN_TENSOR_INT8)
+#ifdef USE_RGA
+// Output memory honoring the placement policy, SRAM is only tried for
+// MEM_PLACEMENT_SRAM_ALL and whatever does not fit stays in DRAM
+static rknn_tensor_mem *create_output_mem(rknn_context ctx, rknn_app_context_t *app_ctx, uint32_t size)
+{
+    uint64_t cache_flag = 0;
+    if (app_ctx->output_cache_mode == OUTPUT_CACHE_UNCACHED)
     {
-        app_ctx->is_quant = true;
+        cache_flag = RKNN_FLAG_MEMORY_NON_CACHEABLE;
     }
-    else
+    else if (app_ctx->output_cache_mode == OUTPUT_CACHE_CACHED)
     {
-        app_ctx->is_quant = false;
+        cache_flag = RKNN_FLAG_MEMORY_CACHEABLE;
     }
 
-    // 获取标准属性用于后续处理
-    rknn_tensor_attr input_attrs[io_num.n_input];
-    memset(input_attrs, 0, sizeof(input_attrs));
-    for (int i = 0; i < io_num.n_input; i++)
+    if (app_ctx->mem_placement != MEM_PLACEMENT_SRAM_ALL)
     {
-        input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
-        {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
+        return cache_flag != 0 ? rknn_create_mem2(ctx, size, cache_flag) : rknn_create_mem(ctx, size);
     }
 
-    rknn_tensor_attr output_attrs[io_num.n_output];
-    memset(output_attrs, 0, sizeof(output_attrs));
-    for (int i = 0; i < io_num.n_output; i++)
+    uint32_t free_before = get_free_sram_size(ctx);
+    rknn_tensor_mem *mem = rknn_create_mem2(ctx, size, RKNN_FLAG_MEMORY_TRY_ALLOC_SRAM | cache_flag);
+    if (mem == NULL)
     {
-        output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
-        {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
-        }
+        return cache_flag != 0 ? rknn_create_mem2(ctx, size, cache_flag) : rknn_create_mem(ctx, size);
+    }
+    uint32_t free_after = get_free_sram_size(ctx);
+    if (free_before > free_after)
+    {
+        app_ctx->output_sram_size += free_before - free_after;
     }
+    return mem;
+}
 
-    app_ctx->input_native_attrs = (rknn_tensor_attr *)malloc(io_num.n_input * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->input_native_attrs, input_native_attrs, io_num.n_input * sizeof(rknn_tensor_attr));
-    app_ctx->output_native_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->output_native_attrs, output_native_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
+// Input buffers owned by the detector rather than the runtime: DMA32 heap so
+// RGA can write them directly, imported into the context once
+static int create_input_ring(rknn_context ctx, rknn_app_context_t *app_ctx, uint32_t size)
+{
+    int n = app_ctx->input_ring_size;
+    if (n < 3)
+    {
+        n = 3;
+    }
+    if (n < app_ctx->async_depth + 1)
+    {
+        // a buffer is reused only after every in-flight frame had its own
+        n = app_ctx->async_depth + 1;
+    }
+    if (n > YOLO11_MAX_INPUT_RING)
+    {
+        n = YOLO11_MAX_INPUT_RING;
+    }
+    app_ctx->input_ring_size = n;
+    app_ctx->input_ring_next = 0;
+    memset(app_ctx->input_ring, 0, sizeof(app_ctx->input_ring));
+    memset(app_ctx->input_ring_mems, 0, sizeof(app_ctx->input_ring_mems));
 
-#else
-    // 标准版本：获取输入输出属性
-    printf("input tensors:\n");
-    rknn_tensor_attr input_attrs[io_num.n_input];
-    memset(input_attrs, 0, sizeof(input_attrs));
-    for (int i = 0; i < io_num.n_input; i++)
+    for (int k = 0; k < n; k++)
     {
-        input_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
+        rknn_dma_buf *buf = &app_ctx->input_ring[k];
+        int fd = -1;
+        void *va = NULL;
+        if (dma_buf_alloc(DMA_HEAP_DMA32_UNCACHED_PATH, size, &fd, &va) < 0)
         {
-            printf("rknn_query fail! ret=%d\n", ret);
+            printf("dma_buf_alloc for input ring %d fail!\n", k);
+            return -1;
+        }
+        buf->dma_buf_fd = fd;
+        buf->dma_buf_virt_addr = (char *)va;
+        buf->size = size;
+        app_ctx->input_ring_mems[k] = rknn_create_mem_from_fd(ctx, fd, va, size, 0);
+        if (app_ctx->input_ring_mems[k] == NULL)
+        {
+            printf("rknn_create_mem_from_fd for input ring %d fail!\n", k);
             return -1;
         }
-        dump_tensor_attr(&(input_attrs[i]));
     }
+    printf("input ring of %d dma buffers, %u bytes each\n", n, size);
+    return 0;
+}
 
-    // Get Model Output Info
-    printf("output tensors:\n");
-    rknn_tensor_attr output_attrs[io_num.n_output];
-    memset(output_attrs, 0, sizeof(output_attrs));
-    for (int i = 0; i < io_num.n_output; i++)
+static void release_input_ring(rknn_app_context_t *app_ctx)
+{
+    for (int k = 0; k < YOLO11_MAX_INPUT_RING; k++)
     {
-        output_attrs[i].index = i;
-        ret = rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
-        if (ret != RKNN_SUCC)
+        if (app_ctx->input_ring_mems[k] != NULL)
         {
-            printf("rknn_query fail! ret=%d\n", ret);
-            return -1;
+            rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->input_ring_mems[k]);
+            app_ctx->input_ring_mems[k] = NULL;
+        }
+        rknn_dma_buf *buf = &app_ctx->input_ring[k];
+        if (buf->dma_buf_virt_addr != NULL)
+        {
+            dma_buf_free(buf->size, &buf->dma_buf_fd, buf->dma_buf_virt_addr);
+            buf->dma_buf_virt_addr = NULL;
         }
-        dump_tensor_attr(&(output_attrs[i]));
     }
+}
+#endif
 
-    // TODO
-    if (output_attrs[0].qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && output_attrs[0].type == RKNN_TENSOR_INT8)
+// Height and width of dynamic shape s of input 0
+static void get_dyn_shape_hw(const rknn_input_range *range, int s, int *height, int *width)
+{
+    const uint32_t *dims = range->dyn_range[s];
+    if (range->fmt == RKNN_TENSOR_NCHW)
     {
-        app_ctx->is_quant = true;
+        *height = dims[2];
+        *width = dims[3];
     }
     else
     {
-        app_ctx->is_quant = false;
+        *height = dims[1];
+        *width = dims[2];
     }
-#endif
+}
 
-    // Set to context
-    app_ctx->rknn_ctx = ctx;
+static int set_dyn_shape(rknn_context ctx, rknn_app_context_t *app_ctx, int s)
+{
+    rknn_tensor_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.index = 0;
+    int ret = rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &attr, sizeof(attr));
+    if (ret != RKNN_SUCC)
+    {
+        printf("rknn_query fail! ret=%d\n", ret);
+        return -1;
+    }
+    attr.fmt = app_ctx->dyn_range->fmt;
+    attr.n_dims = app_ctx->dyn_range->n_dims;
+    for (uint32_t d = 0; d < attr.n_dims; d++)
+    {
+        attr.dims[d] = app_ctx->dyn_range->dyn_range[s][d];
+    }
+    ret = rknn_set_input_shapes(ctx, 1, &attr);
+    if (ret < 0)
+    {
+        printf("rknn_set_input_shapes fail! ret=%d\n", ret);
+        return -1;
+    }
+    app_ctx->dyn_shape_index = s;
+    return 0;
+}
 
-    app_ctx->io_num = io_num;
-    app_ctx->input_attrs = (rknn_tensor_attr *)malloc(io_num.n_input * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->input_attrs, input_attrs, io_num.n_input * sizeof(rknn_tensor_attr));
-    app_ctx->output_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
-    memcpy(app_ctx->output_attrs, output_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
+// Detect a dynamic shape model and set its largest shape, so the attributes
+// queried by setup describe the biggest tensors
+static int init_dynamic_shape(rknn_context ctx, rknn_app_context_t *app_ctx, uint32_t n_input)
+{
+    app_ctx->is_dynamic = false;
+    app_ctx->dyn_range = NULL;
+    app_ctx->dyn_shape_index = -1;
+
+    rknn_input_range *range = (rknn_input_range *)malloc(sizeof(rknn_input_range));
+    if (range == NULL)
+    {
+        return -1;
+    }
+    memset(range, 0, sizeof(rknn_input_range));
+    range->index = 0;
+    int ret = rknn_query(ctx, RKNN_QUERY_INPUT_DYNAMIC_RANGE, range, sizeof(rknn_input_range));
+    if (ret != RKNN_SUCC || range->shape_number == 0 || range->n_dims != 4)
+    {
+        // static shape model
+        free(range);
+        return 0;
+    }
+    if (n_input != 1)
+    {
+        printf("dynamic shape models with %d inputs are not supported\n", n_input);
+        free(range);
+        return -1;
+    }
+    app_ctx->is_dynamic = true;
+    app_ctx->dyn_range = range;
 
-    if (input_attrs[0].fmt == RKNN_TENSOR_NCHW)
+    int largest = 0;
+    int largest_area = 0;
+    printf("dynamic input shapes:");
+    for (uint32_t s = 0; s < range->shape_number; s++)
     {
-        printf("model is NCHW input fmt\n");
-        app_ctx->model_channel = input_attrs[0].dims[1];
-        app_ctx->model_height = input_attrs[0].dims[2];
-        app_ctx->model_width = input_attrs[0].dims[3];
+        int height, width;
+        get_dyn_shape_hw(range, s, &height, &width);
+        printf(" %dx%d", width, height);
+        if (width * height > largest_area)
+        {
+            largest_area = width * height;
+            largest = s;
+        }
+    }
+    printf("\n");
+    return set_dyn_shape(ctx, app_ctx, largest);
+}
+
+static void set_model_dims(rknn_app_context_t *app_ctx)
+{
+    rknn_tensor_attr *input_attr = &app_ctx->input_attrs[0];
+    app_ctx->model_batch = input_attr->dims[0] > 0 ? input_attr->dims[0] : 1;
+    if (input_attr->fmt == RKNN_TENSOR_NCHW)
+    {
+        app_ctx->model_channel = input_attr->dims[1];
+        app_ctx->model_height = input_attr->dims[2];
+        app_ctx->model_width = input_attr->dims[3];
     }
     else
     {
-        printf("model is NHWC input fmt\n");
-        app_ctx->model_height = input_attrs[0].dims[1];
-        app_ctx->model_width = input_attrs[0].dims[2];
-        app_ctx->model_channel = input_attrs[0].dims[3];
+        app_ctx->model_height = input_attr->dims[1];
+        app_ctx->model_width = input_attr->dims[2];
+        app_ctx->model_channel = input_attr->dims[3];
     }
-    printf("model input height=%d, width=%d, channel=%d\n",
-           app_ctx->model_height, app_ctx->model_width, app_ctx->model_channel);
+}
+
+#ifdef USE_RGA
+static uint32_t get_type_size(rknn_tensor_type type)
+{
+    switch (type)
+    {
+    case RKNN_TENSOR_FLOAT32: return 4;
+    case RKNN_TENSOR_FLOAT16: return 2;
+    default: return 1;
+    }
+}
 
+// Outputs that post_process can not decode in their native layout are bound in
+// their plain layout instead, the runtime converts them after every run.
+// An int8 fused head too coarse for its scores is bound the same way as float.
+// native_attrs then holds the attr the output memory is bound with.
+static int select_output_layouts(rknn_context ctx, rknn_query_cmd attr_cmd, uint32_t n_output,
+                                 rknn_tensor_attr *native_attrs)
+{
+    for (uint32_t i = 0; i < n_output; i++)
+    {
+        rknn_tensor_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.index = i;
+        if (rknn_query(ctx, attr_cmd, &attr, sizeof(attr)) != RKNN_SUCC)
+        {
+            printf("rknn_query output %d fail!\n", i);
+            return -1;
+        }
+        bool to_float = post_process_needs_float(&attr, n_output);
+        if (!to_float && post_process_reads_native(&attr, &native_attrs[i], n_output))
+        {
+            continue;
+        }
+        if (to_float)
+        {
+            printf("output %d: int8 scale %f can not resolve the score threshold, bound as float\n", i, attr.scale);
+            attr.type = RKNN_TENSOR_FLOAT32;
+        }
+        else
+        {
+            printf("output %d: %s layout is not decoded in place, bound as %s\n", i,
+                   get_format_string(native_attrs[i].fmt), get_format_string(attr.fmt));
+        }
+        attr.size = attr.n_elems * get_type_size(attr.type);
+        attr.size_with_stride = attr.size;
+        native_attrs[i] = attr;
+    }
     return 0;
 }
 
-int NC1HWC2_i8_to_NCHW_i8(const int8_t *src, int8_t *dst, int *dims, int channel, int h, int w, int zp, float scale)
+// Largest native io sizes over all dynamic shapes, the io memory is created
+// once with them. The shape selected before the call is set again afterwards.
+static int get_dynamic_io_sizes(rknn_context ctx, rknn_app_context_t *app_ctx, uint32_t n_output,
+                                uint32_t *input_size, uint32_t *output_sizes)
 {
-    int batch = dims[0];
-    int C1 = dims[1];
-    int C2 = dims[4];
-    int hw_src = dims[2] * dims[3];
-    int hw_dst = h * w;
-    for (int i = 0; i < batch; i++)
+    int selected = app_ctx->dyn_shape_index;
+    rknn_tensor_attr attr;
+
+    for (uint32_t s = 0; s < app_ctx->dyn_range->shape_number; s++)
     {
-        const int8_t *src_b = src + i * C1 * hw_src * C2;
-        int8_t *dst_b = dst + i * channel * hw_dst;
-        for (int c = 0; c < channel; ++c)
+        if (set_dyn_shape(ctx, app_ctx, s) != 0)
+        {
+            return -1;
+        }
+        memset(&attr, 0, sizeof(attr));
+        attr.index = 0;
+        if (rknn_query(ctx, RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR, &attr, sizeof(attr)) != RKNN_SUCC)
+        {
+            printf("rknn_query RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR fail!\n");
+            return -1;
+        }
+        if (attr.size_with_stride > *input_size)
         {
-            int plane = c / C2;
-            const int8_t *src_bc = plane * hw_src * C2 + src_b;
-            int offset = c % C2;
-            for (int cur_h = 0; cur_h < h; ++cur_h)
-                for (int cur_w = 0; cur_w < w; ++cur_w)
-                {
-                    int cur_hw = cur_h * w + cur_w;
-                    dst_b[c * hw_dst + cur_hw] = src_bc[C2 * cur_hw + offset]; // int8-->int8
-                }
+            *input_size = attr.size_with_stride;
+        }
+        for (uint32_t i = 0; i < n_output; i++)
+        {
+            memset(&attr, 0, sizeof(attr));
+            attr.index = i;
+            if (rknn_query(ctx, RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR, &attr, sizeof(attr)) != RKNN_SUCC)
+            {
+                printf("rknn_query RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR fail!\n");
+                return -1;
+            }
+            if (attr.size_with_stride > output_sizes[i])
+            {
+                output_sizes[i] = attr.size_with_stride;
+            }
         }
     }
-
+    return set_dyn_shape(ctx, app_ctx, selected);
+}
+
+// Empty io sets, done before anything in the init can fail so that
+// release_yolo11_model never sees the fence fd 0 of a zeroed context
+static void init_io_sets(rknn_app_context_t *app_ctx)
+{
+    if (app_ctx->async_depth > YOLO11_MAX_IO_SETS)
+    {
+        app_ctx->async_depth = YOLO11_MAX_IO_SETS;
+    }
+    memset(app_ctx->io_sets, 0, sizeof(app_ctx->io_sets));
+    for (int k = 0; k < YOLO11_MAX_IO_SETS; k++)
+    {
+        app_ctx->io_sets[k].fence_fd = -1;
+    }
+}
+#endif
+
+// Query tensor attributes of an initialized context and bind its io memory.
+// Shared by init_yolo11_model and dup_yolo11_model.
+static int setup_yolo11_model(rknn_context ctx, rknn_app_context_t *app_ctx)
+{
+    int ret;
+
+    // Get Model Input Output Number
+    rknn_input_output_num io_num;
+    ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+    if (ret != RKNN_SUCC)
+    {
+        printf("rknn_query fail! ret=%d\n", ret);
+        return -1;
+    }
+    printf("model input num: %d, output num: %d\n", io_num.n_input, io_num.n_output);
+
+    ret = init_dynamic_shape(ctx, app_ctx, io_num.n_input);
+    if (ret != 0)
+    {
+        return -1;
+    }
+    // dynamic shape models report the shape currently set
+    rknn_query_cmd input_attr_cmd = app_ctx->is_dynamic ? RKNN_QUERY_CURRENT_INPUT_ATTR : RKNN_QUERY_INPUT_ATTR;
+    rknn_query_cmd output_attr_cmd = app_ctx->is_dynamic ? RKNN_QUERY_CURRENT_OUTPUT_ATTR : RKNN_QUERY_OUTPUT_ATTR;
+
+#ifdef USE_RGA
+    // 零拷贝版本：使用native属性，创建内存对象
+    printf("input tensors (native):\n");
+    rknn_tensor_attr input_native_attrs[io_num.n_input];
+    memset(input_native_attrs, 0, sizeof(input_native_attrs));
+    for (int i = 0; i < io_num.n_input; i++)
+    {
+        input_native_attrs[i].index = i;
+        ret = rknn_query(ctx, app_ctx->is_dynamic ? RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR : RKNN_QUERY_NATIVE_INPUT_ATTR,
+                         &(input_native_attrs[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        dump_tensor_attr(&(input_native_attrs[i]));
+    }
+
+    // default input type is int8 (normalize and quantize need compute in outside)
+    // if set uint8, will fuse normalize and quantize to npu
+    input_native_attrs[0].type = RKNN_TENSOR_UINT8;
+
+    // Get Model Output Info
+    printf("output tensors (native):\n");
+    rknn_tensor_attr output_native_attrs[io_num.n_output];
+    memset(output_native_attrs, 0, sizeof(output_native_attrs));
+    for (int i = 0; i < io_num.n_output; i++)
+    {
+        output_native_attrs[i].index = i;
+        ret = rknn_query(ctx, app_ctx->is_dynamic ? RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR : RKNN_QUERY_NATIVE_OUTPUT_ATTR,
+                         &(output_native_attrs[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        dump_tensor_attr(&(output_native_attrs[i]));
+    }
+    if (select_output_layouts(ctx, output_attr_cmd, io_num.n_output, output_native_attrs) != 0)
+    {
+        return -1;
+    }
+
+    // io memory sizes, the largest over all shapes for dynamic shape models
+    uint32_t input_mem_size = input_native_attrs[0].size_with_stride;
+    uint32_t output_mem_sizes[io_num.n_output];
+    for (uint32_t i = 0; i < io_num.n_output; ++i)
+    {
+        output_mem_sizes[i] = output_native_attrs[i].size_with_stride;
+    }
+    if (app_ctx->is_dynamic && get_dynamic_io_sizes(ctx, app_ctx, io_num.n_output, &input_mem_size, output_mem_sizes) != 0)
+    {
+        return -1;
+    }
+
+    if (app_ctx->input_ring_size > 0)
+    {
+        if (create_input_ring(ctx, app_ctx, input_mem_size) != 0)
+        {
+            return -1;
+        }
+        app_ctx->input_mems[0] = app_ctx->input_ring_mems[0];
+    }
+    else
+    {
+        app_ctx->input_mems[0] = rknn_create_mem(ctx, input_mem_size);
+    }
+
+    // Set input tensor memory
+    ret = rknn_set_io_mem(ctx, app_ctx->input_mems[0], &input_native_attrs[0]);
+    if (ret < 0)
+    {
+        printf("input_mems rknn_set_io_mem fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    // Set output tensor memory
+    app_ctx->output_sram_size = 0;
+    for (uint32_t i = 0; i < io_num.n_output; ++i)
+    {
+        app_ctx->output_mems[i] = create_output_mem(ctx, app_ctx, output_mem_sizes[i]);
+        ret = rknn_set_io_mem(ctx, app_ctx->output_mems[i], &output_native_attrs[i]);
+        if (ret < 0)
+        {
+            printf("output_mems rknn_set_io_mem fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+
+    // Extra io sets for the async pipeline, set 0 is the one bound above
+    app_ctx->io_sets[0].input_mems[0] = app_ctx->input_mems[0];
+    for (uint32_t i = 0; i < io_num.n_output; ++i)
+    {
+        app_ctx->io_sets[0].output_mems[i] = app_ctx->output_mems[i];
+    }
+    for (int k = 1; k < app_ctx->async_depth; k++)
+    {
+        // with an input ring the io sets take their input from it at submit
+        app_ctx->io_sets[k].input_mems[0] =
+            app_ctx->input_ring_size > 0 ? app_ctx->input_ring_mems[0] : rknn_create_mem(ctx, input_mem_size);
+        if (app_ctx->io_sets[k].input_mems[0] == NULL)
+        {
+            printf("rknn_create_mem for io set %d fail!\n", k);
+            return -1;
+        }
+        for (uint32_t i = 0; i < io_num.n_output; ++i)
+        {
+            app_ctx->io_sets[k].output_mems[i] = create_output_mem(ctx, app_ctx, output_mem_sizes[i]);
+            if (app_ctx->io_sets[k].output_mems[i] == NULL)
+            {
+                printf("rknn_create_mem for io set %d fail!\n", k);
+                return -1;
+            }
+        }
+    }
+    app_ctx->io_set_head = 0;
+    app_ctx->io_set_tail = 0;
+    app_ctx->io_set_pending = 0;
+    if (app_ctx->async_depth > 1)
+    {
+        printf("async inference enabled, %d io sets\n", app_ctx->async_depth);
+    }
+
+    // TODO
+    if (output_native_attrs[0].qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && output_native_attrs[0].type == RKNN_TENSOR_INT8)
+    {
+        app_ctx->is_quant = true;
+    }
+    else
+    {
+        app_ctx->is_quant = false;
+    }
+
+    // 获取标准属性用于后续处理
+    rknn_tensor_attr input_attrs[io_num.n_input];
+    memset(input_attrs, 0, sizeof(input_attrs));
+    for (int i = 0; i < io_num.n_input; i++)
+    {
+        input_attrs[i].index = i;
+        ret = rknn_query(ctx, input_attr_cmd, &(input_attrs[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+
+    rknn_tensor_attr output_attrs[io_num.n_output];
+    memset(output_attrs, 0, sizeof(output_attrs));
+    for (int i = 0; i < io_num.n_output; i++)
+    {
+        output_attrs[i].index = i;
+        ret = rknn_query(ctx, output_attr_cmd, &(output_attrs[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+
+    app_ctx->input_native_attrs = (rknn_tensor_attr *)malloc(io_num.n_input * sizeof(rknn_tensor_attr));
+    memcpy(app_ctx->input_native_attrs, input_native_attrs, io_num.n_input * sizeof(rknn_tensor_attr));
+    app_ctx->output_native_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
+    memcpy(app_ctx->output_native_attrs, output_native_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
+
+    // NC1HWC2 outputs are decoded in place, the other layouts get a copy
+    // reused by every frame instead of a malloc/free per tensor
+    for (uint32_t i = 0; i < io_num.n_output; ++i)
+    {
+        if (output_native_attrs[i].fmt == RKNN_TENSOR_NC1HWC2)
+        {
+            continue;
+        }
+        app_ctx->output_bufs[i] = (int8_t *)malloc(output_mem_sizes[i]);
+        if (app_ctx->output_bufs[i] == NULL)
+        {
+            printf("malloc output buffer %d fail!\n", i);
+            return -1;
+        }
+    }
+
+#else
+    // 标准版本：获取输入输出属性
+    printf("input tensors:\n");
+    rknn_tensor_attr input_attrs[io_num.n_input];
+    memset(input_attrs, 0, sizeof(input_attrs));
+    for (int i = 0; i < io_num.n_input; i++)
+    {
+        input_attrs[i].index = i;
+        ret = rknn_query(ctx, input_attr_cmd, &(input_attrs[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        dump_tensor_attr(&(input_attrs[i]));
+    }
+
+    // Get Model Output Info
+    printf("output tensors:\n");
+    rknn_tensor_attr output_attrs[io_num.n_output];
+    memset(output_attrs, 0, sizeof(output_attrs));
+    for (int i = 0; i < io_num.n_output; i++)
+    {
+        output_attrs[i].index = i;
+        ret = rknn_query(ctx, output_attr_cmd, &(output_attrs[i]), sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+        dump_tensor_attr(&(output_attrs[i]));
+    }
+
+    // TODO
+    if (output_attrs[0].qnt_type == RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC && output_attrs[0].type == RKNN_TENSOR_INT8)
+    {
+        app_ctx->is_quant = true;
+    }
+    else
+    {
+        app_ctx->is_quant = false;
+    }
+#endif
+
+    // Set to context
+    app_ctx->rknn_ctx = ctx;
+
+    app_ctx->io_num = io_num;
+    app_ctx->input_attrs = (rknn_tensor_attr *)malloc(io_num.n_input * sizeof(rknn_tensor_attr));
+    memcpy(app_ctx->input_attrs, input_attrs, io_num.n_input * sizeof(rknn_tensor_attr));
+    app_ctx->output_attrs = (rknn_tensor_attr *)malloc(io_num.n_output * sizeof(rknn_tensor_attr));
+    memcpy(app_ctx->output_attrs, output_attrs, io_num.n_output * sizeof(rknn_tensor_attr));
+
+    printf("model is %s input fmt\n", input_attrs[0].fmt == RKNN_TENSOR_NCHW ? "NCHW" : "NHWC");
+    set_model_dims(app_ctx);
+    printf("model input height=%d, width=%d, channel=%d\n",
+           app_ctx->model_height, app_ctx->model_width, app_ctx->model_channel);
+
+    if (app_ctx->model_batch > 1)
+    {
+        int core_num = app_ctx->batch_core_num;
+        if (core_num <= 0)
+        {
+            core_num = app_ctx->model_batch < 3 ? app_ctx->model_batch : 3;
+        }
+        ret = rknn_set_batch_core_num(ctx, core_num);
+        if (ret < 0)
+        {
+            printf("rknn_set_batch_core_num(%d) fail! ret=%d\n", core_num, ret);
+        }
+        printf("model batch=%d, spread over %d cores\n", app_ctx->model_batch, core_num);
+    }
+
+    ret = init_post_process_branches(app_ctx);
+    if (ret != 0)
+    {
+        return -1;
+    }
+    ret = init_post_process_scratch(app_ctx);
+    if (ret != 0)
+    {
+        printf("init_post_process_scratch fail! ret=%d\n", ret);
+        return -1;
+    }
+    app_ctx->frame_alloc_count = 0;
+    app_ctx->frame_count = 0;
+
+    return 0;
+}
+
+// rknn_init flags derived from the options set in app_ctx
+static uint32_t get_init_flags(rknn_app_context_t *app_ctx)
+{
+    uint32_t flag = 0;
+#ifdef USE_RGA
+    if (app_ctx->async_depth > 1)
+    {
+        flag |= RKNN_FLAG_ASYNC_MASK;
+    }
+#endif
+    if (app_ctx->priority == YOLO11_PRIORITY_MEDIUM)
+    {
+        flag |= RKNN_FLAG_PRIOR_MEDIUM;
+    }
+    else if (app_ctx->priority == YOLO11_PRIORITY_LOW)
+    {
+        flag |= RKNN_FLAG_PRIOR_LOW;
+    }
+    if (app_ctx->collect_perf)
+    {
+        flag |= RKNN_FLAG_COLLECT_PERF_MASK;
+    }
+#ifdef USE_RGA
+    if (app_ctx->output_cache_mode == OUTPUT_CACHE_CACHED)
+    {
+        flag |= RKNN_FLAG_DISABLE_FLUSH_OUTPUT_MEM_CACHE;
+    }
+    if (app_ctx->device_written_input)
+    {
+        flag |= RKNN_FLAG_DISABLE_FLUSH_INPUT_MEM_CACHE;
+    }
+    if (app_ctx->use_fence)
+    {
+        flag |= RKNN_FLAG_FENCE_IN_OUTSIDE | RKNN_FLAG_FENCE_OUT_OUTSIDE;
+    }
+#endif
+    if (app_ctx->mem_placement != MEM_PLACEMENT_DRAM)
+    {
+        flag |= RKNN_FLAG_ENABLE_SRAM;
+        if (app_ctx->share_sram)
+        {
+            flag |= RKNN_FLAG_SHARE_SRAM;
+        }
+    }
+    return flag;
+}
+
+static const char *get_mem_placement_string(mem_placement_t placement)
+{
+    switch (placement)
+    {
+    case MEM_PLACEMENT_SRAM_INTERNAL: return "sram-internal";
+    case MEM_PLACEMENT_SRAM_ALL: return "sram-all";
+    default: return "dram";
+    }
+}
+
+static int create_yolo11_model(const char *model_path, uint32_t flag, rknn_context share_ctx, rknn_app_context_t *app_ctx)
+{
+    int ret;
+    rknn_context ctx = 0;
+
+#ifdef USE_RGA
+    init_io_sets(app_ctx);
+#endif
+    // Load RKNN Model
+    ret = load_yolo11_model(model_path, flag, share_ctx, app_ctx, &ctx);
+    if (ret != 0 && (flag & RKNN_FLAG_ENABLE_SRAM))
+    {
+        // platform without (enough) SRAM, keep going in DRAM
+        printf("rknn_init with SRAM fail, fall back to DRAM\n");
+        app_ctx->mem_placement = MEM_PLACEMENT_DRAM;
+        flag &= ~(RKNN_FLAG_ENABLE_SRAM | RKNN_FLAG_SHARE_SRAM);
+        ret = load_yolo11_model(model_path, flag, share_ctx, app_ctx, &ctx);
+    }
+    if (ret != 0)
+    {
+        return -1;
+    }
+
+    ret = setup_yolo11_model(ctx, app_ctx);
+    if (ret != 0)
+    {
+        rknn_destroy(ctx);
+        app_ctx->rknn_ctx = 0;
+        if (app_ctx->model_mem != NULL)
+        {
+            rknn_destroy_mem(0, app_ctx->model_mem);
+            app_ctx->model_mem = NULL;
+        }
+        return -1;
+    }
+    dump_yolo11_mem_size(app_ctx);
+    return 0;
+}
+
+int init_yolo11_model(const char *model_path, rknn_app_context_t *app_ctx)
+{
+    return create_yolo11_model(model_path, get_init_flags(app_ctx), 0, app_ctx);
+}
+
+int init_yolo11_model_shared(const char *model_path, rknn_app_context_t *primary_ctx, rknn_app_context_t *app_ctx)
+{
+    if (primary_ctx == NULL || primary_ctx->rknn_ctx == 0)
+    {
+        printf("init_yolo11_model_shared: primary context is not initialized\n");
+        return -1;
+    }
+    // weights come from primary_ctx, internal and io memory stay per context
+    return create_yolo11_model(model_path, get_init_flags(app_ctx) | RKNN_FLAG_SHARE_WEIGHT_MEM,
+                               primary_ctx->rknn_ctx, app_ctx);
+}
+
+int dump_yolo11_mem_size(rknn_app_context_t *app_ctx)
+{
+    rknn_mem_size mem_size;
+    memset(&mem_size, 0, sizeof(mem_size));
+    int ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_MEM_SIZE, &mem_size, sizeof(mem_size));
+    if (ret != RKNN_SUCC)
+    {
+        printf("rknn_query RKNN_QUERY_MEM_SIZE fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    uint64_t io_size = 0;
+#ifdef USE_RGA
+    int n_io_sets = app_ctx->async_depth > 1 ? app_ctx->async_depth : 1;
+    int n_inputs = app_ctx->input_ring_size > 0 ? app_ctx->input_ring_size : n_io_sets;
+    for (uint32_t i = 0; i < app_ctx->io_num.n_input; i++)
+    {
+        io_size += (uint64_t)app_ctx->input_native_attrs[i].size_with_stride * n_inputs;
+    }
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        io_size += (uint64_t)app_ctx->output_native_attrs[i].size_with_stride * n_io_sets;
+    }
+#endif
+    // zero copy loads keep the model file in NPU memory for the context lifetime
+    uint64_t model_buffer_size = app_ctx->model_mem != NULL ? app_ctx->model_mem->size : 0;
+    printf("context mem: weight=%.2f MB, internal=%.2f MB, io=%.2f MB, model buffer=%.2f MB, dma allocated=%.2f MB, sram total=%.2f KB free=%.2f KB\n",
+           mem_size.total_weight_size / 1048576.0, mem_size.total_internal_size / 1048576.0, io_size / 1048576.0,
+           model_buffer_size / 1048576.0, mem_size.total_dma_allocated_size / 1048576.0,
+           mem_size.total_sram_size / 1024.0, mem_size.free_sram_size / 1024.0);
+    if (app_ctx->mem_placement != MEM_PLACEMENT_DRAM)
+    {
+        uint32_t sram_used = mem_size.total_sram_size - mem_size.free_sram_size;
+#ifdef USE_RGA
+        uint32_t output_sram = app_ctx->output_sram_size;
+#else
+        uint32_t output_sram = 0;
+#endif
+        printf("mem placement=%s: sram used=%.2f KB (outputs %.2f KB, internal %.2f KB)\n",
+               get_mem_placement_string(app_ctx->mem_placement), sram_used / 1024.0, output_sram / 1024.0,
+               (sram_used > output_sram ? sram_used - output_sram : 0) / 1024.0);
+    }
+    return 0;
+}
+
+int dup_yolo11_model(rknn_app_context_t *src_ctx, rknn_app_context_t *dst_ctx, rknn_core_mask core_mask)
+{
+    int ret;
+    rknn_context ctx = 0;
+
+    if (src_ctx == NULL || dst_ctx == NULL || src_ctx->rknn_ctx == 0)
+    {
+        return -1;
+    }
+#ifdef USE_RGA
+    init_io_sets(dst_ctx);
+#endif
+
+    // The duplicated context shares the weights of src_ctx, so the model file is
+    // neither read nor loaded again; only io memory is allocated per context.
+    ret = rknn_dup_context(&src_ctx->rknn_ctx, &ctx);
+    if (ret < 0)
+    {
+        printf("rknn_dup_context fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    ret = setup_yolo11_model(ctx, dst_ctx);
+    if (ret != 0)
+    {
+        rknn_destroy(ctx);
+        dst_ctx->rknn_ctx = 0;
+        return -1;
+    }
+
+    ret = rknn_set_core_mask(ctx, core_mask);
+    if (ret < 0)
+    {
+        // single core platforms (RK3566/RK3568) reject explicit core masks
+        printf("rknn_set_core_mask(%d) fail! ret=%d, keep default core\n", core_mask, ret);
+    }
+    dump_yolo11_mem_size(dst_ctx);
+    return 0;
+}
+
+#ifdef USE_RGA
+// Sleep until a sync_file fence signals, then drop it. RKNN_ERR_TIMEOUT when
+// it has not signalled within timeout_ms (> 0)
+static int wait_fence(int fence_fd, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = fence_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    // run_timeout_ms bounds the wait like it bounds rknn_wait, 0 waits forever
+    double deadline = get_time_ms() + timeout_ms;
+    int ret;
+    do
+    {
+        int wait_ms = -1;
+        if (timeout_ms > 0)
+        {
+            double left = deadline - get_time_ms();
+            wait_ms = left > 0 ? (int)(left + 0.5) : 0;
+        }
+        ret = poll(&pfd, 1, wait_ms);
+    } while (ret < 0 && errno == EINTR);
+    close(fence_fd);
+    if (ret == 0)
+    {
+        printf("wait fence %d timed out after %d ms\n", fence_fd, timeout_ms);
+        return RKNN_ERR_TIMEOUT;
+    }
+    if (ret < 0 || (pfd.revents & (POLLERR | POLLNVAL)))
+    {
+        printf("wait fence %d fail! ret=%d revents=0x%x\n", fence_fd, ret, pfd.revents);
+        return -1;
+    }
+    return 0;
+}
+
+// Wait for the frames still on the NPU, so release never destroys io memory the
+// NPU is writing. Each wait is bounded by run_timeout_ms. The frames are never
+// async_waited, their admission slots are given back here.
+static void drain_io_sets(rknn_app_context_t *app_ctx)
+{
+    while (app_ctx->io_set_pending > 0)
+    {
+        yolo11_io_set_t *io_set = &app_ctx->io_sets[app_ctx->io_set_tail];
+        app_ctx->io_set_tail = (app_ctx->io_set_tail + 1) % app_ctx->async_depth;
+        app_ctx->io_set_pending--;
+        if (io_set->fence_fd >= 0)
+        {
+            wait_fence(io_set->fence_fd, app_ctx->run_timeout_ms);
+            io_set->fence_fd = -1;
+        }
+        rknn_run_extend run_ext;
+        memset(&run_ext, 0, sizeof(run_ext));
+        run_ext.frame_id = io_set->frame_id;
+        run_ext.timeout_ms = app_ctx->run_timeout_ms;
+        int ret = rknn_wait(app_ctx->rknn_ctx, &run_ext);
+        if (ret < 0)
+        {
+            printf("rknn_wait frame %llu at release fail! ret=%d\n", (unsigned long long)io_set->frame_id, ret);
+        }
+        io_set->img = NULL;
+        yolo11_sched_finish(app_ctx->priority, -1);
+    }
+}
+#endif
+
+int release_yolo11_model(rknn_app_context_t *app_ctx)
+{
+    // keep going on errors, a context left by a driver reset still has to give
+    // back everything it can
+    int result = 0;
+#ifdef USE_RGA
+    if (app_ctx->rknn_ctx != 0)
+    {
+        drain_io_sets(app_ctx);
+    }
+#endif
+    release_post_process_scratch(app_ctx);
+    if (app_ctx->input_attrs != NULL)
+    {
+        free(app_ctx->input_attrs);
+        app_ctx->input_attrs = NULL;
+    }
+    if (app_ctx->output_attrs != NULL)
+    {
+        free(app_ctx->output_attrs);
+        app_ctx->output_attrs = NULL;
+    }
+    if (app_ctx->dyn_range != NULL)
+    {
+        free(app_ctx->dyn_range);
+        app_ctx->dyn_range = NULL;
+    }
+#ifdef USE_RGA
+    for (int i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        if (app_ctx->output_bufs[i] != NULL)
+        {
+            free(app_ctx->output_bufs[i]);
+            app_ctx->output_bufs[i] = NULL;
+        }
+    }
+    if (app_ctx->input_native_attrs != NULL)
+    {
+        free(app_ctx->input_native_attrs);
+        app_ctx->input_native_attrs = NULL;
+    }
+    if (app_ctx->output_native_attrs != NULL)
+    {
+        free(app_ctx->output_native_attrs);
+        app_ctx->output_native_attrs = NULL;
+    }
+
+    if (app_ctx->input_ring_size > 0)
+    {
+        // the input pointers only alias ring buffers
+        release_input_ring(app_ctx);
+        app_ctx->input_mems[0] = NULL;
+        for (int k = 0; k < YOLO11_MAX_IO_SETS; k++)
+        {
+            app_ctx->io_sets[k].input_mems[0] = NULL;
+        }
+    }
+    for (int i = 0; i < app_ctx->io_num.n_input; i++)
+    {
+        if (app_ctx->input_mems[i] != NULL)
+        {
+            int ret = rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->input_mems[i]);
+            if (ret != RKNN_SUCC)
+            {
+                printf("rknn_destroy_mem fail! ret=%d\n", ret);
+                result = -1;
+            }
+            app_ctx->input_mems[i] = NULL;
+        }
+    }
+    for (int i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        if (app_ctx->output_mems[i] != NULL)
+        {
+            int ret = rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->output_mems[i]);
+            if (ret != RKNN_SUCC)
+            {
+                printf("rknn_destroy_mem fail! ret=%d\n", ret);
+                result = -1;
+            }
+            app_ctx->output_mems[i] = NULL;
+        }
+    }
+    for (int k = 1; k < app_ctx->async_depth; k++)
+    {
+        rknn_tensor_mem **mems = app_ctx->io_sets[k].output_mems;
+        for (int i = 0; i < app_ctx->io_num.n_output; i++)
+        {
+            if (mems[i] != NULL)
+            {
+                rknn_destroy_mem(app_ctx->rknn_ctx, mems[i]);
+                mems[i] = NULL;
+            }
+        }
+        if (app_ctx->io_sets[k].input_mems[0] != NULL)
+        {
+            rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->io_sets[k].input_mems[0]);
+            app_ctx->io_sets[k].input_mems[0] = NULL;
+        }
+    }
+#endif
+    if (app_ctx->rknn_ctx != 0)
+    {
+        rknn_destroy(app_ctx->rknn_ctx);
+        app_ctx->rknn_ctx = 0;
+    }
+    if (app_ctx->model_mem != NULL)
+    {
+        rknn_destroy_mem(0, app_ctx->model_mem);
+        app_ctx->model_mem = NULL;
+    }
+    return result;
+}
+
+// Accumulate the CPU side timings and write the periodic perf report
+static void record_stage_times(rknn_app_context_t *app_ctx, double preprocess_ms, double npu_ms, double postprocess_ms)
+{
+    yolo11_stage_times_t *st = &app_ctx->stage_times;
+    st->preprocess_ms = preprocess_ms;
+    st->npu_ms = npu_ms;
+    st->postprocess_ms = postprocess_ms;
+    st->preprocess_sum_ms += preprocess_ms;
+    st->npu_sum_ms += npu_ms;
+    st->postprocess_sum_ms += postprocess_ms;
+    st->frames++;
+
+    if (app_ctx->perf_report_path != NULL && app_ctx->perf_report_interval > 0 &&
+        st->frames % app_ctx->perf_report_interval == 0)
+    {
+        dump_yolo11_perf(app_ctx, app_ctx->perf_report_path);
+    }
+}
+
+#ifdef USE_RGA
+static int bind_io_set(rknn_app_context_t *app_ctx, yolo11_io_set_t *io_set)
+{
+    int ret = rknn_set_io_mem(app_ctx->rknn_ctx, io_set->input_mems[0], &app_ctx->input_native_attrs[0]);
+    if (ret < 0)
+    {
+        printf("input_mems rknn_set_io_mem fail! ret=%d\n", ret);
+        return -1;
+    }
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        ret = rknn_set_io_mem(app_ctx->rknn_ctx, io_set->output_mems[i], &app_ctx->output_native_attrs[i]);
+        if (ret < 0)
+        {
+            printf("output_mems rknn_set_io_mem fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Input memory for the next frame: the next ring buffer, bound to the context
+// unless the caller binds a whole io set, or the fixed input memory without a ring
+static rknn_tensor_mem *acquire_input_mem(rknn_app_context_t *app_ctx, bool bind)
+{
+    if (app_ctx->input_ring_size <= 0)
+    {
+        return app_ctx->input_mems[0];
+    }
+    rknn_tensor_mem *mem = app_ctx->input_ring_mems[app_ctx->input_ring_next];
+    if (bind)
+    {
+        int ret = rknn_set_io_mem(app_ctx->rknn_ctx, mem, &app_ctx->input_native_attrs[0]);
+        if (ret < 0)
+        {
+            printf("input ring rknn_set_io_mem fail! ret=%d\n", ret);
+            return NULL;
+        }
+    }
+    app_ctx->input_ring_next = (app_ctx->input_ring_next + 1) % app_ctx->input_ring_size;
+    app_ctx->input_mems[0] = mem;
+    return mem;
+}
+
+// RGA writes the letterboxed frame straight into the NPU input memory, a
+// non zero slot of a batched input is addressed through the virtual address
+static int letterbox_to_input_mem(rknn_app_context_t *app_ctx, image_buffer_t *img, rknn_tensor_mem *input_mem, int slot,
+                                  letterbox_t *letter_box, int *release_fence_fd)
+{
+    int ret;
+    image_buffer_t dst_img;
+    int bg_color = 114;
+
+    memset(letter_box, 0, sizeof(letterbox_t));
+    memset(&dst_img, 0, sizeof(image_buffer_t));
+    dst_img.width = app_ctx->model_width;
+    dst_img.height = app_ctx->model_height;
+    dst_img.format = IMAGE_FORMAT_RGB888;
+    dst_img.size = get_image_size(&dst_img);
+    dst_img.fd = input_mem->fd;
+    dst_img.virt_addr = (unsigned char *)input_mem->virt_addr;
+    if (slot > 0)
+    {
+        dst_img.fd = 0;
+        dst_img.virt_addr += slot * (app_ctx->input_native_attrs[0].size_with_stride / app_ctx->model_batch);
+    }
+
+    if (dst_img.virt_addr == NULL && dst_img.fd == 0)
+    {
+        printf("malloc buffer size:%d fail!\n", dst_img.size);
+        return -1;
+    }
+
+    if (release_fence_fd != NULL)
+    {
+        ret = convert_image_with_letterbox_async(img, &dst_img, letter_box, bg_color, release_fence_fd);
+    }
+    else
+    {
+        ret = convert_image_with_letterbox(img, &dst_img, letter_box, bg_color);
+    }
+    if (ret < 0)
+    {
+        printf("convert_image_with_letterbox fail! ret=%d\n", ret);
+        return -1;
+    }
+    return 0;
+}
+
+// rknn_run on the bound io memory. In fence mode the job is gated by in_fence
+// (consumed here) so the CPU never waits for RGA, and the output fence of a
+// non blocking run is returned in run_ext->fence_fd, -1 otherwise.
+static int run_npu(rknn_app_context_t *app_ctx, int in_fence, int non_block, rknn_run_extend *run_ext)
+{
+    memset(run_ext, 0, sizeof(rknn_run_extend));
+    run_ext->non_block = non_block;
+    run_ext->timeout_ms = non_block ? 0 : app_ctx->run_timeout_ms;
+    run_ext->fence_fd = app_ctx->use_fence ? in_fence : 0;
+    int ret = rknn_run(app_ctx->rknn_ctx, run_ext);
+    if (in_fence >= 0)
+    {
+        close(in_fence);
+    }
+    if (ret < 0)
+    {
+        printf("rknn_run fail! ret=%d\n", ret);
+        return ret;
+    }
+    if (!app_ctx->use_fence)
+    {
+        run_ext->fence_fd = -1;
+    }
+    else if (!non_block && run_ext->fence_fd >= 0)
+    {
+        close(run_ext->fence_fd);
+        run_ext->fence_fd = -1;
+    }
+    return 0;
+}
+
+// Outputs of the branches excluded by branch_mask/min_object_size are never read
+static bool is_output_active(rknn_app_context_t *app_ctx, uint32_t i)
+{
+    if (app_ctx->n_branch == 0)
+    {
+        return true;
+    }
+    return (app_ctx->active_branches >> (i / app_ctx->output_per_branch)) & 1;
+}
+
+// With OUTPUT_CACHE_CACHED the runtime leaves the output cache alone, one
+// invalidate per tensor per run makes the NPU results visible to the CPU
+static int sync_output_mems(rknn_app_context_t *app_ctx, rknn_tensor_mem **output_mems)
+{
+    if (app_ctx->output_cache_mode != OUTPUT_CACHE_CACHED)
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        if (!is_output_active(app_ctx, i))
+        {
+            continue;
+        }
+        int ret = rknn_mem_sync(app_ctx->rknn_ctx, output_mems[i], RKNN_MEMORY_SYNC_FROM_DEVICE);
+        if (ret < 0)
+        {
+            printf("rknn_mem_sync output %d fail! ret=%d\n", i, ret);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int post_process_output_mems(rknn_app_context_t *app_ctx, rknn_tensor_mem **output_mems, int slot,
+                                    letterbox_t *letter_box, object_detect_result_list *od_results)
+{
+    int ret = 0;
+    rknn_output outputs[app_ctx->io_num.n_output];
+    const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
+    const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
+
+    // NC1HWC2 tensors are handed to post_process as is, it decodes the native
+    // layout, int8 for quantized models and fp16 otherwise.
+    // Batched outputs are split along N, slot selects the slice of one frame.
+    memset(outputs, 0, sizeof(outputs));
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        int8_t *base = (int8_t *)output_mems[i]->virt_addr;
+        if (app_ctx->output_native_attrs[i].fmt == RKNN_TENSOR_NC1HWC2)
+        {
+            outputs[i].size = app_ctx->output_native_attrs[i].size_with_stride / app_ctx->model_batch;
+            outputs[i].buf = base + slot * outputs[i].size;
+        }
+        else
+        {
+            outputs[i].size = app_ctx->output_native_attrs[i].n_elems / app_ctx->model_batch *
+                              get_type_size(app_ctx->output_native_attrs[i].type);
+            if (app_ctx->output_cache_mode == OUTPUT_CACHE_CACHED)
+            {
+                // strided reads are cheap from cached memory, no staging copy
+                outputs[i].buf = base + slot * outputs[i].size;
+                continue;
+            }
+            outputs[i].buf = app_ctx->output_bufs[i];
+            if (is_output_active(app_ctx, i))
+            {
+                memcpy(outputs[i].buf, base + slot * outputs[i].size, outputs[i].size);
+            }
+        }
+    }
+
+    // Post Process
+    ret = post_process(app_ctx, outputs, letter_box, box_conf_threshold, nms_threshold, od_results);
+    return ret;
+}
+#endif
+
+// Heap allocations made so far by the calling thread, 0 without YOLO11_ALLOC_DEBUG
+static uint64_t thread_alloc_count()
+{
+#ifdef YOLO11_ALLOC_DEBUG
+    return alloc_debug_count();
+#else
+    return 0;
+#endif
+}
+
+// Account the heap allocations of a completed frame (letterbox, run, output
+// sync and post process), any after the warmup frames is reported
+static void account_frame_allocs(rknn_app_context_t *app_ctx, uint64_t allocs)
+{
+#ifdef YOLO11_ALLOC_DEBUG
+    const uint64_t warmup_frames = 3;
+    app_ctx->frame_alloc_count = allocs;
+    if (app_ctx->frame_count >= warmup_frames && allocs != 0)
+    {
+        printf("WARNING: frame %llu made %llu heap allocations after warmup\n",
+               (unsigned long long)app_ctx->frame_count, (unsigned long long)allocs);
+    }
+#else
+    (void)allocs;
+#endif
+    app_ctx->frame_count++;
+}
+
+// Re-query the attributes of the shape currently set and rebind the io memory
+static int refresh_io_attrs(rknn_app_context_t *app_ctx)
+{
+    int ret;
+    for (uint32_t i = 0; i < app_ctx->io_num.n_input; i++)
+    {
+        app_ctx->input_attrs[i].index = i;
+        ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_CURRENT_INPUT_ATTR, &app_ctx->input_attrs[i], sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        app_ctx->output_attrs[i].index = i;
+        ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_CURRENT_OUTPUT_ATTR, &app_ctx->output_attrs[i], sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+#ifdef USE_RGA
+    for (uint32_t i = 0; i < app_ctx->io_num.n_input; i++)
+    {
+        app_ctx->input_native_attrs[i].index = i;
+        ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_CURRENT_NATIVE_INPUT_ATTR, &app_ctx->input_native_attrs[i], sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    app_ctx->input_native_attrs[0].type = RKNN_TENSOR_UINT8;
+    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    {
+        app_ctx->output_native_attrs[i].index = i;
+        ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_CURRENT_NATIVE_OUTPUT_ATTR, &app_ctx->output_native_attrs[i], sizeof(rknn_tensor_attr));
+        if (ret != RKNN_SUCC)
+        {
+            printf("rknn_query fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    if (select_output_layouts(app_ctx->rknn_ctx, RKNN_QUERY_CURRENT_OUTPUT_ATTR, app_ctx->io_num.n_output,
+                              app_ctx->output_native_attrs) != 0)
+    {
+        return -1;
+    }
+    // async io sets are bound again at submit
+    if (bind_io_set(app_ctx, &app_ctx->io_sets[0]) != 0)
+    {
+        return -1;
+    }
+#endif
+    set_model_dims(app_ctx);
     return 0;
 }
 
-int release_yolo11_model(rknn_app_context_t *app_ctx)
+int select_yolo11_input_shape(rknn_app_context_t *app_ctx, int src_width, int src_height)
 {
-    if (app_ctx->input_attrs != NULL)
+    if (app_ctx == NULL || src_width <= 0 || src_height <= 0)
     {
-        free(app_ctx->input_attrs);
-        app_ctx->input_attrs = NULL;
+        return -1;
     }
-    if (app_ctx->output_attrs != NULL)
+    if (!app_ctx->is_dynamic)
     {
-        free(app_ctx->output_attrs);
-        app_ctx->output_attrs = NULL;
+        return 0;
     }
 #ifdef USE_RGA
-    if (app_ctx->input_native_attrs != NULL)
-    {
-        free(app_ctx->input_native_attrs);
-        app_ctx->input_native_attrs = NULL;
-    }
-    if (app_ctx->output_native_attrs != NULL)
+    if (app_ctx->io_set_pending > 0)
     {
-        free(app_ctx->output_native_attrs);
-        app_ctx->output_native_attrs = NULL;
+        printf("can not change the input shape with frames in flight\n");
+        return -1;
     }
+#endif
 
-    for (int i = 0; i < app_ctx->io_num.n_input; i++)
+    // fraction of the model input left as letterbox padding, ties within 1%
+    // go to the smaller shape
+    int best = -1;
+    float best_padding = 0;
+    int best_area = 0;
+    for (uint32_t s = 0; s < app_ctx->dyn_range->shape_number; s++)
     {
-        if (app_ctx->input_mems[i] != NULL)
+        int height, width;
+        get_dyn_shape_hw(app_ctx->dyn_range, s, &height, &width);
+        float scale_w = (float)width / src_width;
+        float scale_h = (float)height / src_height;
+        float scale = scale_w < scale_h ? scale_w : scale_h;
+        float padding = 1.0f - (src_width * scale) * (src_height * scale) / ((float)width * height);
+        int area = width * height;
+        if (best < 0 || padding < best_padding - 0.01f || (padding < best_padding + 0.01f && area < best_area))
         {
-            int ret = rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->input_mems[i]);
-            if (ret != RKNN_SUCC)
-            {
-                printf("rknn_destroy_mem fail! ret=%d\n", ret);
-                return -1;
-            }
+            best = s;
+            best_padding = padding;
+            best_area = area;
         }
     }
-    for (int i = 0; i < app_ctx->io_num.n_output; i++)
+
+    if (best == app_ctx->dyn_shape_index)
     {
-        if (app_ctx->output_mems[i] != NULL)
-        {
-            int ret = rknn_destroy_mem(app_ctx->rknn_ctx, app_ctx->output_mems[i]);
-            if (ret != RKNN_SUCC)
-            {
-                printf("rknn_destroy_mem fail! ret=%d\n", ret);
-                return -1;
-            }
-        }
+        return 0;
     }
-#endif
-    if (app_ctx->rknn_ctx != 0)
+    if (set_dyn_shape(app_ctx->rknn_ctx, app_ctx, best) != 0 || refresh_io_attrs(app_ctx) != 0)
     {
-        rknn_destroy(app_ctx->rknn_ctx);
-        app_ctx->rknn_ctx = 0;
+        return -1;
     }
+    printf("input shape %dx%d for %dx%d source, %.0f%% padding\n", app_ctx->model_width, app_ctx->model_height,
+           src_width, src_height, best_padding * 100);
     return 0;
 }
 
-int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results)
+static int run_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results)
 {
     int ret;
     image_buffer_t dst_img;
     letterbox_t letter_box;
     rknn_input inputs[app_ctx->io_num.n_input];
     rknn_output outputs[app_ctx->io_num.n_output];
-    const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
-    const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
-    int bg_color = 114;
 
     if ((!app_ctx) || !(img) || (!od_results))
     {
@@ -344,90 +1590,82 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     memset(inputs, 0, sizeof(inputs));
     memset(outputs, 0, sizeof(outputs));
 
-    // Pre Process
-    dst_img.width = app_ctx->model_width;
-    dst_img.height = app_ctx->model_height;
-    dst_img.format = IMAGE_FORMAT_RGB888;
-    dst_img.size = get_image_size(&dst_img);
-
 #ifdef USE_RGA
     // 零拷贝版本：使用RKNN管理的内存
-    dst_img.fd = app_ctx->input_mems[0]->fd;
-    dst_img.virt_addr = (unsigned char *)app_ctx->input_mems[0]->virt_addr;
-
-    if (dst_img.virt_addr == NULL && dst_img.fd == 0)
+    if (app_ctx->async_depth > 1)
     {
-        printf("malloc buffer size:%d fail!\n", dst_img.size);
-        return -1;
+        // the async pipeline may have left another io set bound
+        ret = bind_io_set(app_ctx, &app_ctx->io_sets[0]);
+        if (ret < 0)
+        {
+            return -1;
+        }
     }
-#else
-    // 标准版本：动态分配内存
-    dst_img.virt_addr = (unsigned char *)malloc(dst_img.size);
-    if (dst_img.virt_addr == NULL)
+
+    rknn_tensor_mem *input_mem = acquire_input_mem(app_ctx, true);
+    if (input_mem == NULL)
     {
-        printf("malloc buffer size:%d fail!\n", dst_img.size);
         return -1;
     }
-#endif
+    app_ctx->io_sets[0].input_mems[0] = input_mem;
 
     // letterbox
-    ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
+    double t0 = get_time_ms();
+    int in_fence = -1;
+    ret = letterbox_to_input_mem(app_ctx, img, input_mem, 0, &letter_box,
+                                 app_ctx->use_fence ? &in_fence : NULL);
     if (ret < 0)
     {
-        printf("convert_image_with_letterbox fail! ret=%d\n", ret);
-        goto out;
+        return -1;
     }
 
-#ifdef USE_RGA
     // 零拷贝版本：直接运行，无需设置输入输出
+    double t1 = get_time_ms();
     printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    rknn_run_extend run_ext;
+    ret = run_npu(app_ctx, in_fence, 0, &run_ext);
     if (ret < 0)
     {
-        printf("rknn_run fail! ret=%d\n", ret);
-        goto out;
+        return ret;
     }
 
-    // NC1HWC2 to NCHW
-    memset(outputs, 0, sizeof(outputs));
-    for (uint32_t i = 0; i < app_ctx->io_num.n_output; i++)
+    double t2 = get_time_ms();
+    if (sync_output_mems(app_ctx, app_ctx->output_mems) != 0)
     {
-        int channel = app_ctx->output_attrs[i].dims[1];
-        int h = app_ctx->output_attrs[i].n_dims > 2 ? app_ctx->output_attrs[i].dims[2] : 1;
-        int w = app_ctx->output_attrs[i].n_dims > 3 ? app_ctx->output_attrs[i].dims[3] : 1;
-        int hw = h * w;
-        int zp = app_ctx->output_native_attrs[i].zp;
-        float scale = app_ctx->output_native_attrs[i].scale;
-        if (app_ctx->is_quant)
-        {
-            outputs[i].size = app_ctx->output_native_attrs[i].n_elems * sizeof(int8_t);
-            outputs[i].buf = (int8_t *)malloc(outputs[i].size);
-            if (app_ctx->output_native_attrs[i].fmt == RKNN_TENSOR_NC1HWC2)
-            {
-                NC1HWC2_i8_to_NCHW_i8((int8_t *)app_ctx->output_mems[i]->virt_addr, (int8_t *)outputs[i].buf,
-                                      (int *)app_ctx->output_native_attrs[i].dims, channel, h, w, zp, scale);
-            }
-            else
-            {
-                memcpy(outputs[i].buf, app_ctx->output_mems[i]->virt_addr, outputs[i].size);
-            }
-        }
-        else
-        {
-            printf("Currently zero copy does not support fp16!\n");
-            goto out;
-        }
+        return -1;
     }
+    ret = post_process_output_mems(app_ctx, app_ctx->output_mems, 0, &letter_box, od_results);
+    record_stage_times(app_ctx, t1 - t0, t2 - t1, get_time_ms() - t2);
 
-    // Post Process
-    post_process(app_ctx, outputs, &letter_box, box_conf_threshold, nms_threshold, od_results);
+#else
+    const float nms_threshold = NMS_THRESH;      // 默认的NMS阈值
+    const float box_conf_threshold = BOX_THRESH; // 默认的置信度阈值
+    int bg_color = 114;
+    double t0, t1, t2;
 
-    for (int i = 0; i < app_ctx->io_num.n_output; i++)
+    // Pre Process
+    dst_img.width = app_ctx->model_width;
+    dst_img.height = app_ctx->model_height;
+    dst_img.format = IMAGE_FORMAT_RGB888;
+    dst_img.size = get_image_size(&dst_img);
+
+    // 标准版本：动态分配内存
+    dst_img.virt_addr = (unsigned char *)malloc(dst_img.size);
+    if (dst_img.virt_addr == NULL)
     {
-        free(outputs[i].buf);
+        printf("malloc buffer size:%d fail!\n", dst_img.size);
+        return -1;
+    }
+
+    // letterbox
+    t0 = get_time_ms();
+    ret = convert_image_with_letterbox(img, &dst_img, &letter_box, bg_color);
+    if (ret < 0)
+    {
+        printf("convert_image_with_letterbox fail! ret=%d\n", ret);
+        goto out;
     }
 
-#else
     // 标准版本：设置输入，运行，获取输出
     // Set Input Data
     inputs[0].index = 0;
@@ -444,20 +1682,25 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
     }
 
     // Run
+    t1 = get_time_ms();
     printf("rknn_run\n");
-    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    rknn_run_extend run_ext;
+    memset(&run_ext, 0, sizeof(run_ext));
+    run_ext.timeout_ms = app_ctx->run_timeout_ms;
+    ret = rknn_run(app_ctx->rknn_ctx, &run_ext);
     if (ret < 0)
     {
         printf("rknn_run fail! ret=%d\n", ret);
         goto out;
     }
+    t2 = get_time_ms();
 
     // Get Output
     memset(outputs, 0, sizeof(outputs));
     for (int i = 0; i < app_ctx->io_num.n_output; i++)
     {
         outputs[i].index = i;
-        outputs[i].want_float = (!app_ctx->is_quant);
+        outputs[i].want_float = (!app_ctx->is_quant) || post_process_needs_float(&app_ctx->output_attrs[i], app_ctx->io_num.n_output);
     }
     ret = rknn_outputs_get(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs, NULL);
     if (ret < 0)
@@ -471,14 +1714,269 @@ int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, obj
 
     // Remember to release rknn output
     rknn_outputs_release(app_ctx->rknn_ctx, app_ctx->io_num.n_output, outputs);
-#endif
+    record_stage_times(app_ctx, t1 - t0, t2 - t1, get_time_ms() - t2);
 
 out:
-#ifndef USE_RGA
     if (dst_img.virt_addr != NULL)
     {
         free(dst_img.virt_addr);
     }
 #endif
     return ret;
-}
\ No newline at end of file
+}
+
+int inference_yolo11_model(rknn_app_context_t *app_ctx, image_buffer_t *img, object_detect_result_list *od_results)
+{
+    if ((!app_ctx) || !(img) || (!od_results))
+    {
+        return -1;
+    }
+    if (yolo11_sched_admit(app_ctx->priority) != 0)
+    {
+        memset(od_results, 0x00, sizeof(*od_results));
+        return YOLO11_FRAME_DROPPED;
+    }
+
+    uint64_t allocs_before = thread_alloc_count();
+    double t0 = get_time_ms();
+    int ret = run_yolo11_model(app_ctx, img, od_results);
+    yolo11_sched_finish(app_ctx->priority, ret == 0 ? get_time_ms() - t0 : -1);
+    if (ret == 0)
+    {
+        account_frame_allocs(app_ctx, thread_alloc_count() - allocs_before);
+    }
+    return ret;
+}
+
+#ifdef USE_RGA
+// Letterbox into the next free io set and start it without waiting
+static int start_io_set(rknn_app_context_t *app_ctx, image_buffer_t *img, uint64_t *frame_id)
+{
+    int ret;
+    yolo11_io_set_t *io_set = &app_ctx->io_sets[app_ctx->io_set_head];
+    if (app_ctx->input_ring_size > 0)
+    {
+        io_set->input_mems[0] = acquire_input_mem(app_ctx, false);
+        if (io_set->input_mems[0] == NULL)
+        {
+            return -1;
+        }
+    }
+
+    double t0 = get_time_ms();
+    io_set->submit_ms = t0;
+    int in_fence = -1;
+    ret = letterbox_to_input_mem(app_ctx, img, io_set->input_mems[0], 0, &io_set->letter_box,
+                                 app_ctx->use_fence ? &in_fence : NULL);
+    if (ret < 0)
+    {
+        return -1;
+    }
+    io_set->preprocess_ms = get_time_ms() - t0;
+
+    ret = bind_io_set(app_ctx, io_set);
+    if (ret < 0)
+    {
+        if (in_fence >= 0)
+        {
+            // the caller gets img back, RGA must be done with it
+            wait_fence(in_fence, app_ctx->run_timeout_ms);
+        }
+        return -1;
+    }
+
+    // start the frame and return, the CPU is free to post process the previous one
+    rknn_run_extend run_ext;
+    ret = run_npu(app_ctx, in_fence, 1, &run_ext);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    io_set->frame_id = run_ext.frame_id;
+    io_set->fence_fd = run_ext.fence_fd;
+    // the NPU job waits for the RGA fence, so img is free once the frame is waited
+    io_set->img = app_ctx->use_fence ? img : NULL;
+    if (frame_id != NULL)
+    {
+        *frame_id = run_ext.frame_id;
+    }
+
+    app_ctx->io_set_head = (app_ctx->io_set_head + 1) % app_ctx->async_depth;
+    app_ctx->io_set_pending++;
+    return 0;
+}
+
+// Wait for an io set started by start_io_set and post process it
+static int finish_io_set(rknn_app_context_t *app_ctx, yolo11_io_set_t *io_set, object_detect_result_list *od_results,
+                         uint64_t *frame_id)
+{
+    int ret;
+
+    double t1 = get_time_ms();
+    if (io_set->fence_fd >= 0)
+    {
+        // one wake-up when the NPU signals, rknn_wait below then returns at once
+        ret = wait_fence(io_set->fence_fd, app_ctx->run_timeout_ms);
+        io_set->fence_fd = -1;
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+    rknn_run_extend run_ext;
+    memset(&run_ext, 0, sizeof(run_ext));
+    run_ext.frame_id = io_set->frame_id;
+    run_ext.timeout_ms = app_ctx->run_timeout_ms;
+    ret = rknn_wait(app_ctx->rknn_ctx, &run_ext);
+    if (ret < 0)
+    {
+        printf("rknn_wait fail! ret=%d\n", ret);
+        return ret;
+    }
+    io_set->img = NULL;
+    if (frame_id != NULL)
+    {
+        *frame_id = io_set->frame_id;
+    }
+
+    double t2 = get_time_ms();
+    if (sync_output_mems(app_ctx, io_set->output_mems) != 0)
+    {
+        return -1;
+    }
+    ret = post_process_output_mems(app_ctx, io_set->output_mems, 0, &io_set->letter_box, od_results);
+    record_stage_times(app_ctx, io_set->preprocess_ms, t2 - t1, get_time_ms() - t2);
+    return ret;
+}
+
+int inference_yolo11_model_async_submit(rknn_app_context_t *app_ctx, image_buffer_t *img, uint64_t *frame_id)
+{
+    if ((!app_ctx) || (!img) || app_ctx->async_depth < 2)
+    {
+        return -1;
+    }
+    if (app_ctx->io_set_pending >= app_ctx->async_depth)
+    {
+        printf("all %d io sets in flight, wait for a result first\n", app_ctx->async_depth);
+        return -1;
+    }
+    if (yolo11_sched_admit(app_ctx->priority) != 0)
+    {
+        return YOLO11_FRAME_DROPPED;
+    }
+
+    // submit and wait may run on different threads, each counts its own part
+    uint64_t allocs_before = thread_alloc_count();
+    yolo11_io_set_t *io_set = &app_ctx->io_sets[app_ctx->io_set_head];
+    int ret = start_io_set(app_ctx, img, frame_id);
+    if (ret != 0)
+    {
+        yolo11_sched_finish(app_ctx->priority, -1);
+        return ret;
+    }
+    io_set->submit_allocs = thread_alloc_count() - allocs_before;
+    return 0;
+}
+
+int inference_yolo11_model_async_wait(rknn_app_context_t *app_ctx, object_detect_result_list *od_results, uint64_t *frame_id)
+{
+    if ((!app_ctx) || (!od_results) || app_ctx->io_set_pending <= 0)
+    {
+        return -1;
+    }
+
+    yolo11_io_set_t *io_set = &app_ctx->io_sets[app_ctx->io_set_tail];
+    app_ctx->io_set_tail = (app_ctx->io_set_tail + 1) % app_ctx->async_depth;
+    app_ctx->io_set_pending--;
+
+    uint64_t allocs_before = thread_alloc_count();
+    memset(od_results, 0x00, sizeof(*od_results));
+    int ret = finish_io_set(app_ctx, io_set, od_results, frame_id);
+    yolo11_sched_finish(app_ctx->priority, ret == 0 ? get_time_ms() - io_set->submit_ms : -1);
+    if (ret == 0)
+    {
+        account_frame_allocs(app_ctx, io_set->submit_allocs + thread_alloc_count() - allocs_before);
+    }
+    return ret;
+}
+
+static int run_yolo11_model_batch(rknn_app_context_t *app_ctx, image_buffer_t **imgs, int n, object_detect_result_list *od_results)
+{
+    int ret;
+
+    if (n > app_ctx->model_batch)
+    {
+        printf("%d frames do not fit the model batch %d\n", n, app_ctx->model_batch);
+        return -1;
+    }
+    if (app_ctx->async_depth > 1 && bind_io_set(app_ctx, &app_ctx->io_sets[0]) != 0)
+    {
+        return -1;
+    }
+    rknn_tensor_mem *input_mem = acquire_input_mem(app_ctx, true);
+    if (input_mem == NULL)
+    {
+        return -1;
+    }
+    app_ctx->io_sets[0].input_mems[0] = input_mem;
+
+    letterbox_t letter_boxes[n];
+    double t0 = get_time_ms();
+    for (int b = 0; b < n; b++)
+    {
+        ret = letterbox_to_input_mem(app_ctx, imgs[b], input_mem, b, &letter_boxes[b], NULL);
+        if (ret < 0)
+        {
+            return -1;
+        }
+    }
+
+    double t1 = get_time_ms();
+    rknn_run_extend run_ext;
+    ret = run_npu(app_ctx, -1, 0, &run_ext);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    double t2 = get_time_ms();
+    if (sync_output_mems(app_ctx, app_ctx->output_mems) != 0)
+    {
+        return -1;
+    }
+    for (int b = 0; b < n; b++)
+    {
+        ret = post_process_output_mems(app_ctx, app_ctx->output_mems, b, &letter_boxes[b], &od_results[b]);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    record_stage_times(app_ctx, t1 - t0, t2 - t1, get_time_ms() - t2);
+    return 0;
+}
+
+int inference_yolo11_model_batch(rknn_app_context_t *app_ctx, image_buffer_t **imgs, int n, object_detect_result_list *od_results)
+{
+    if (app_ctx == NULL || imgs == NULL || od_results == NULL || n <= 0)
+    {
+        return -1;
+    }
+    // a batch is admitted and timed as one job
+    if (yolo11_sched_admit(app_ctx->priority) != 0)
+    {
+        memset(od_results, 0x00, n * sizeof(object_detect_result_list));
+        return YOLO11_FRAME_DROPPED;
+    }
+
+    uint64_t allocs_before = thread_alloc_count();
+    double t0 = get_time_ms();
+    int ret = run_yolo11_model_batch(app_ctx, imgs, n, od_results);
+    yolo11_sched_finish(app_ctx->priority, ret == 0 ? get_time_ms() - t0 : -1);
+    if (ret == 0)
+    {
+        account_frame_allocs(app_ctx, thread_alloc_count() - allocs_before);
+    }
+    return ret;
+}
+#endif
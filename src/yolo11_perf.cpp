@@ -0,0 +1,301 @@
+#include "yolo11_perf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <time.h>
+#include <vector>
+
+// Column start of a header title in the fixed width perf detail table, -1 if absent
+static int find_column(const std::string &header, const char *title)
+{
+    size_t pos = header.find(title);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+// Whitespace separated token covering (or following) the given column
+static std::string token_at(const std::string &line, int column)
+{
+    if (column < 0 || column >= (int)line.size())
+    {
+        return "";
+    }
+    int start = column;
+    while (start > 0 && line[start - 1] != ' ')
+    {
+        start--;
+    }
+    while (start < (int)line.size() && line[start] == ' ')
+    {
+        start++;
+    }
+    int end = start;
+    while (end < (int)line.size() && line[end] != ' ')
+    {
+        end++;
+    }
+    return line.substr(start, end - start);
+}
+
+static std::string last_token(const std::string &line)
+{
+    size_t end = line.find_last_not_of(" \r");
+    if (end == std::string::npos)
+    {
+        return "";
+    }
+    size_t start = line.find_last_of(' ', end);
+    start = start == std::string::npos ? 0 : start + 1;
+    return line.substr(start, end - start + 1);
+}
+
+static void write_layer_rows(FILE *fp, const char *perf_data)
+{
+    std::string header;
+    int col_op = -1, col_dtype = -1, col_target = -1, col_time = -1;
+    int n_layers = 0, n_fallback = 0;
+    double total_us = 0;
+
+    const char *p = perf_data;
+    while (*p != '\0')
+    {
+        const char *eol = strchr(p, '\n');
+        std::string line = eol ? std::string(p, eol - p) : std::string(p);
+        p = eol ? eol + 1 : p + line.size();
+
+        if (line.find("OpType") != std::string::npos && line.find("Time(us)") != std::string::npos)
+        {
+            header = line;
+            col_op = find_column(header, "OpType");
+            col_dtype = find_column(header, "DataType");
+            col_target = find_column(header, "Target");
+            col_time = find_column(header, "Time(us)");
+            continue;
+        }
+        // layer rows start with their numeric id, the ranking tables after the
+        // layer table have a different header and are skipped
+        size_t first = line.find_first_not_of(' ');
+        if (header.empty() || first == std::string::npos || line[first] < '0' || line[first] > '9')
+        {
+            if (!header.empty() && line.find("Total") != std::string::npos)
+            {
+                header.clear();
+            }
+            continue;
+        }
+
+        int id = atoi(line.c_str() + first);
+        std::string target = token_at(line, col_target);
+        double time_us = atof(token_at(line, col_time).c_str());
+        bool cpu_fallback = !target.empty() && target != "NPU";
+
+        fprintf(fp, "layer,%d,%s,%s,%s,%.0f,%d,%s\n", id, token_at(line, col_op).c_str(),
+                token_at(line, col_dtype).c_str(), target.c_str(), time_us, cpu_fallback ? 1 : 0,
+                last_token(line).c_str());
+        n_layers++;
+        n_fallback += cpu_fallback ? 1 : 0;
+        total_us += time_us;
+    }
+    printf("perf detail: %d layers, %.0f us, %d not on NPU\n", n_layers, total_us, n_fallback);
+}
+
+int dump_yolo11_perf(rknn_app_context_t *app_ctx, const char *path)
+{
+    int ret;
+
+    if (app_ctx == NULL || path == NULL)
+    {
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        printf("open %s fail!\n", path);
+        return -1;
+    }
+    fprintf(fp, "section,id,op_type,data_type,target,time_us,cpu_fallback,name\n");
+
+    if (app_ctx->collect_perf)
+    {
+        rknn_perf_detail perf_detail;
+        memset(&perf_detail, 0, sizeof(perf_detail));
+        ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_PERF_DETAIL, &perf_detail, sizeof(perf_detail));
+        if (ret == RKNN_SUCC && perf_detail.perf_data != NULL)
+        {
+            write_layer_rows(fp, perf_detail.perf_data);
+        }
+        else
+        {
+            printf("rknn_query RKNN_QUERY_PERF_DETAIL fail! ret=%d\n", ret);
+        }
+    }
+
+    rknn_perf_run perf_run;
+    memset(&perf_run, 0, sizeof(perf_run));
+    ret = rknn_query(app_ctx->rknn_ctx, RKNN_QUERY_PERF_RUN, &perf_run, sizeof(perf_run));
+    if (ret == RKNN_SUCC)
+    {
+        fprintf(fp, "run,,rknn_run,,NPU,%lld,0,run_duration\n", (long long)perf_run.run_duration);
+    }
+
+    // stage timings measured on the host in us, last frame and average over all frames
+    yolo11_stage_times_t *st = &app_ctx->stage_times;
+    double n = st->frames > 0 ? (double)st->frames : 1.0;
+    fprintf(fp, "stage,,preprocess,,CPU,%.0f,0,last\n", st->preprocess_ms * 1000.0);
+    fprintf(fp, "stage,,npu,,NPU,%.0f,0,last\n", st->npu_ms * 1000.0);
+    fprintf(fp, "stage,,postprocess,,CPU,%.0f,0,last\n", st->postprocess_ms * 1000.0);
+    fprintf(fp, "stage,,preprocess,,CPU,%.0f,0,avg\n", st->preprocess_sum_ms * 1000.0 / n);
+    fprintf(fp, "stage,,npu,,NPU,%.0f,0,avg\n", st->npu_sum_ms * 1000.0 / n);
+    fprintf(fp, "stage,,postprocess,,CPU,%.0f,0,avg\n", st->postprocess_sum_ms * 1000.0 / n);
+
+    fclose(fp);
+    printf("perf report written to %s (%llu frames)\n", path, (unsigned long long)st->frames);
+    return 0;
+}
+
+#if defined(ZERO_COPY)
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+int benchmark_yolo11_output_reads(rknn_app_context_t *app_ctx, int iterations)
+{
+    static const char *names[2] = {"uncached", "cached"};
+    static const uint64_t flags[2] = {RKNN_FLAG_MEMORY_NON_CACHEABLE, RKNN_FLAG_MEMORY_CACHEABLE};
+    uint32_t n_output = app_ctx->io_num.n_output;
+    int ret = 0;
+
+    if (iterations <= 0)
+    {
+        return -1;
+    }
+    // representative content for the decode
+    ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+    if (ret < 0)
+    {
+        printf("rknn_run fail! ret=%d\n", ret);
+        return -1;
+    }
+
+    letterbox_t letter_box;
+    memset(&letter_box, 0, sizeof(letter_box));
+    letter_box.scale = 1.0f;
+    object_detect_result_list od_results;
+
+    for (int m = 0; m < 2; m++)
+    {
+        rknn_tensor_mem *mems[n_output];
+        rknn_output outputs[n_output];
+        memset(mems, 0, sizeof(mems));
+        memset(outputs, 0, sizeof(outputs));
+        for (uint32_t i = 0; i < n_output; i++)
+        {
+            uint32_t size = app_ctx->output_native_attrs[i].size_with_stride;
+            mems[i] = rknn_create_mem2(app_ctx->rknn_ctx, size, flags[m]);
+            if (mems[i] == NULL)
+            {
+                printf("rknn_create_mem2 %s fail!\n", names[m]);
+                ret = -1;
+                break;
+            }
+            rknn_mem_sync(app_ctx->rknn_ctx, app_ctx->output_mems[i], RKNN_MEMORY_SYNC_FROM_DEVICE);
+            memcpy(mems[i]->virt_addr, app_ctx->output_mems[i]->virt_addr, size);
+            rknn_mem_sync(app_ctx->rknn_ctx, mems[i], RKNN_MEMORY_SYNC_TO_DEVICE);
+            outputs[i].buf = mems[i]->virt_addr;
+            outputs[i].size = size;
+        }
+
+        if (ret == 0)
+        {
+            // plain sequential read of every byte
+            volatile uint32_t sink = 0;
+            double t0 = now_ms();
+            for (int it = 0; it < iterations; it++)
+            {
+                for (uint32_t i = 0; i < n_output; i++)
+                {
+                    if (m == 1)
+                    {
+                        rknn_mem_sync(app_ctx->rknn_ctx, mems[i], RKNN_MEMORY_SYNC_FROM_DEVICE);
+                    }
+                    const uint32_t *p = (const uint32_t *)mems[i]->virt_addr;
+                    uint32_t acc = 0;
+                    for (uint32_t k = 0; k < outputs[i].size / 4; k++)
+                    {
+                        acc += p[k];
+                    }
+                    sink += acc;
+                }
+            }
+            double read_ms = (now_ms() - t0) / iterations;
+
+            // the real access pattern, score planes for every cell and boxes of the candidates
+            t0 = now_ms();
+            for (int it = 0; it < iterations; it++)
+            {
+                if (m == 1)
+                {
+                    for (uint32_t i = 0; i < n_output; i++)
+                    {
+                        rknn_mem_sync(app_ctx->rknn_ctx, mems[i], RKNN_MEMORY_SYNC_FROM_DEVICE);
+                    }
+                }
+                post_process(app_ctx, outputs, &letter_box, BOX_THRESH, NMS_THRESH, &od_results);
+            }
+            double decode_ms = (now_ms() - t0) / iterations;
+            printf("output reads %-8s: sequential %.3f ms/frame, post_process %.3f ms/frame\n", names[m], read_ms,
+                   decode_ms);
+        }
+
+        for (uint32_t i = 0; i < n_output; i++)
+        {
+            if (mems[i] != NULL)
+            {
+                rknn_destroy_mem(app_ctx->rknn_ctx, mems[i]);
+            }
+        }
+        if (ret != 0)
+        {
+            break;
+        }
+    }
+    return ret;
+}
+
+int benchmark_yolo11_input_flush(rknn_app_context_t *app_ctx, int iterations)
+{
+    if (iterations <= 0)
+    {
+        return -1;
+    }
+
+    double t0 = now_ms();
+    for (int it = 0; it < iterations; it++)
+    {
+        int ret = rknn_run(app_ctx->rknn_ctx, nullptr);
+        if (ret < 0)
+        {
+            printf("rknn_run fail! ret=%d\n", ret);
+            return -1;
+        }
+    }
+    double run_ms = (now_ms() - t0) / iterations;
+
+    t0 = now_ms();
+    for (int it = 0; it < iterations; it++)
+    {
+        rknn_mem_sync(app_ctx->rknn_ctx, app_ctx->input_mems[0], RKNN_MEMORY_SYNC_TO_DEVICE);
+    }
+    double flush_ms = (now_ms() - t0) / iterations;
+
+    printf("input flush: rknn_run %.3f ms/frame (%s), input cache flush %.3f ms/frame\n", run_ms,
+           app_ctx->device_written_input ? "flush disabled" : "runtime flushes", flush_ms);
+    return 0;
+}
+#endif
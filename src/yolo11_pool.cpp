@@ -0,0 +1,244 @@
+#include "yolo11_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct {
+    uint64_t frame_id;
+    image_buffer_t* img;
+} yolo11_pool_job_t;
+
+typedef struct {
+    int ret;
+    object_detect_result_list od_results;
+} yolo11_pool_result_t;
+
+typedef struct {
+    rknn_app_context_t app_ctx;
+    std::thread thread;
+    std::deque<yolo11_pool_job_t> jobs;
+    std::condition_variable job_cond;
+    int busy; // queued + running frames
+} yolo11_pool_worker_t;
+
+struct yolo11_pool {
+    std::vector<yolo11_pool_worker_t*> workers;
+    yolo11_pool_policy_t policy;
+    int next_worker;
+    uint64_t next_frame_id;
+    uint64_t next_result_id;
+    // reorder buffer, keyed by frame id
+    std::map<uint64_t, yolo11_pool_result_t> done;
+    std::mutex mutex;
+    std::condition_variable done_cond;
+    bool stop;
+};
+
+static void pool_worker_loop(yolo11_pool_t* pool, yolo11_pool_worker_t* worker)
+{
+    yolo11_pool_result_t result;
+
+    for (;;)
+    {
+        yolo11_pool_job_t job;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            while (!pool->stop && worker->jobs.empty())
+            {
+                worker->job_cond.wait(lock);
+            }
+            if (worker->jobs.empty())
+            {
+                return;
+            }
+            job = worker->jobs.front();
+            worker->jobs.pop_front();
+        }
+
+        result.ret = inference_yolo11_model(&worker->app_ctx, job.img, &result.od_results);
+
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->done[job.frame_id] = result;
+            worker->busy--;
+        }
+        pool->done_cond.notify_all();
+    }
+}
+
+static int pool_pick_worker(yolo11_pool_t* pool)
+{
+    int n = (int)pool->workers.size();
+    if (pool->policy == YOLO11_POOL_LEAST_BUSY)
+    {
+        // start from the round robin position so ties still rotate over the cores
+        int best = pool->next_worker;
+        for (int i = 1; i < n; i++)
+        {
+            int idx = (pool->next_worker + i) % n;
+            if (pool->workers[idx]->busy < pool->workers[best]->busy)
+            {
+                best = idx;
+            }
+        }
+        pool->next_worker = (best + 1) % n;
+        return best;
+    }
+    int idx = pool->next_worker;
+    pool->next_worker = (idx + 1) % n;
+    return idx;
+}
+
+int init_yolo11_pool(const char* model_path, int n_workers, yolo11_pool_policy_t policy, yolo11_pool_t** pool)
+{
+    static const rknn_core_mask core_masks[3] = {RKNN_NPU_CORE_0, RKNN_NPU_CORE_1, RKNN_NPU_CORE_2};
+    int ret;
+
+    if (model_path == NULL || pool == NULL || n_workers <= 0)
+    {
+        return -1;
+    }
+
+    yolo11_pool_t* p = new yolo11_pool_t();
+    p->policy = policy;
+    p->next_worker = 0;
+    p->next_frame_id = 0;
+    p->next_result_id = 0;
+    p->stop = false;
+
+    for (int i = 0; i < n_workers; i++)
+    {
+        yolo11_pool_worker_t* worker = new yolo11_pool_worker_t();
+        memset(&worker->app_ctx, 0, sizeof(worker->app_ctx));
+        worker->busy = 0;
+
+        if (i == 0)
+        {
+            ret = init_yolo11_model(model_path, &worker->app_ctx);
+            if (ret == 0 && rknn_set_core_mask(worker->app_ctx.rknn_ctx, core_masks[0]) < 0)
+            {
+                printf("rknn_set_core_mask(%d) fail! keep default core\n", core_masks[0]);
+            }
+        }
+        else
+        {
+            ret = dup_yolo11_model(&p->workers[0]->app_ctx, &worker->app_ctx, core_masks[i % 3]);
+        }
+        if (ret != 0)
+        {
+            printf("init pool worker %d fail! ret=%d\n", i, ret);
+            delete worker;
+            release_yolo11_pool(p);
+            return -1;
+        }
+        p->workers.push_back(worker);
+    }
+
+    for (size_t i = 0; i < p->workers.size(); i++)
+    {
+        p->workers[i]->thread = std::thread(pool_worker_loop, p, p->workers[i]);
+    }
+    printf("yolo11 pool: %d workers, policy=%s\n", n_workers,
+           policy == YOLO11_POOL_LEAST_BUSY ? "least-busy" : "round-robin");
+
+    *pool = p;
+    return 0;
+}
+
+int yolo11_pool_submit(yolo11_pool_t* pool, image_buffer_t* img, uint64_t* frame_id)
+{
+    if (pool == NULL || img == NULL || pool->workers.empty())
+    {
+        return -1;
+    }
+
+    yolo11_pool_worker_t* worker;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        yolo11_pool_job_t job;
+        job.frame_id = pool->next_frame_id++;
+        job.img = img;
+        worker = pool->workers[pool_pick_worker(pool)];
+        worker->jobs.push_back(job);
+        worker->busy++;
+        if (frame_id != NULL)
+        {
+            *frame_id = job.frame_id;
+        }
+    }
+    worker->job_cond.notify_one();
+    return 0;
+}
+
+int yolo11_pool_get_result(yolo11_pool_t* pool, object_detect_result_list* od_results, uint64_t* frame_id)
+{
+    if (pool == NULL || od_results == NULL)
+    {
+        return -1;
+    }
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    if (pool->next_result_id == pool->next_frame_id)
+    {
+        return -1;
+    }
+
+    std::map<uint64_t, yolo11_pool_result_t>::iterator it;
+    while ((it = pool->done.find(pool->next_result_id)) == pool->done.end())
+    {
+        pool->done_cond.wait(lock);
+    }
+
+    int ret = it->second.ret;
+    memcpy(od_results, &it->second.od_results, sizeof(object_detect_result_list));
+    if (frame_id != NULL)
+    {
+        *frame_id = it->first;
+    }
+    pool->done.erase(it);
+    pool->next_result_id++;
+    return ret;
+}
+
+int release_yolo11_pool(yolo11_pool_t* pool)
+{
+    int ret = 0;
+
+    if (pool == NULL)
+    {
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stop = true;
+    }
+    for (size_t i = 0; i < pool->workers.size(); i++)
+    {
+        pool->workers[i]->job_cond.notify_all();
+    }
+
+    // duplicated contexts go first, worker 0 owns the loaded model
+    for (int i = (int)pool->workers.size() - 1; i >= 0; i--)
+    {
+        yolo11_pool_worker_t* worker = pool->workers[i];
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+        if (release_yolo11_model(&worker->app_ctx) != 0)
+        {
+            ret = -1;
+        }
+        delete worker;
+    }
+    delete pool;
+    return ret;
+}
@@ -0,0 +1,149 @@
+#include "yolo11_sched.h"
+
+#include <stdio.h>
+
+#include <atomic>
+
+// 0.1 ms buckets up to 200 ms, slower frames land in the last one
+#define LATENCY_BUCKET_MS 0.1
+#define LATENCY_BUCKETS 2000
+
+typedef struct {
+    std::atomic<uint64_t> buckets[LATENCY_BUCKETS + 1];
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> max_us;
+} latency_histogram_t;
+
+static latency_histogram_t g_latency[YOLO11_PRIORITY_NUM];
+static std::atomic<int> g_inflight(0);
+static std::atomic<int> g_max_inflight(0);
+
+void set_yolo11_admission_limit(int max_inflight)
+{
+    g_max_inflight.store(max_inflight > 0 ? max_inflight : 0);
+}
+
+int yolo11_sched_admit(yolo11_priority_t priority)
+{
+    int limit = g_max_inflight.load(std::memory_order_relaxed);
+    if (limit <= 0 || priority == YOLO11_PRIORITY_HIGH)
+    {
+        g_inflight.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    int low_limit = limit / 2 > 0 ? limit / 2 : 1;
+    int allowed = priority == YOLO11_PRIORITY_LOW ? low_limit : limit;
+    // check and reserve in one step, concurrent detectors can not both take the last slot
+    int cur = g_inflight.load(std::memory_order_relaxed);
+    do
+    {
+        if (cur >= allowed)
+        {
+            g_latency[priority].dropped.fetch_add(1, std::memory_order_relaxed);
+            return YOLO11_FRAME_DROPPED;
+        }
+    } while (!g_inflight.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed));
+    return 0;
+}
+
+void yolo11_sched_finish(yolo11_priority_t priority, double latency_ms)
+{
+    g_inflight.fetch_sub(1, std::memory_order_relaxed);
+    if (latency_ms < 0 || priority < 0 || priority >= YOLO11_PRIORITY_NUM)
+    {
+        return;
+    }
+
+    latency_histogram_t *h = &g_latency[priority];
+    int bucket = (int)(latency_ms / LATENCY_BUCKET_MS);
+    if (bucket > LATENCY_BUCKETS)
+    {
+        bucket = LATENCY_BUCKETS;
+    }
+    h->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    h->frames.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t us = (uint64_t)(latency_ms * 1000.0);
+    uint64_t prev = h->max_us.load(std::memory_order_relaxed);
+    while (us > prev && !h->max_us.compare_exchange_weak(prev, us, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Upper edge of the bucket holding the given fraction of the frames
+static double histogram_percentile(latency_histogram_t *h, uint64_t frames, double fraction)
+{
+    uint64_t rank = (uint64_t)(frames * fraction);
+    if (rank >= frames)
+    {
+        rank = frames - 1;
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b <= LATENCY_BUCKETS; b++)
+    {
+        seen += h->buckets[b].load(std::memory_order_relaxed);
+        if (seen > rank)
+        {
+            return (b + 1) * LATENCY_BUCKET_MS;
+        }
+    }
+    return (LATENCY_BUCKETS + 1) * LATENCY_BUCKET_MS;
+}
+
+int get_yolo11_latency_stats(yolo11_priority_t priority, yolo11_latency_stats_t *stats)
+{
+    if (stats == NULL || priority < 0 || priority >= YOLO11_PRIORITY_NUM)
+    {
+        return -1;
+    }
+
+    latency_histogram_t *h = &g_latency[priority];
+    stats->frames = h->frames.load(std::memory_order_relaxed);
+    stats->dropped = h->dropped.load(std::memory_order_relaxed);
+    stats->max_ms = h->max_us.load(std::memory_order_relaxed) / 1000.0;
+    stats->p50_ms = 0;
+    stats->p99_ms = 0;
+    if (stats->frames > 0)
+    {
+        stats->p50_ms = histogram_percentile(h, stats->frames, 0.50);
+        stats->p99_ms = histogram_percentile(h, stats->frames, 0.99);
+        // bucket edges can overshoot the slowest frame
+        stats->p50_ms = stats->p50_ms < stats->max_ms ? stats->p50_ms : stats->max_ms;
+        stats->p99_ms = stats->p99_ms < stats->max_ms ? stats->p99_ms : stats->max_ms;
+    }
+    return 0;
+}
+
+void reset_yolo11_latency_stats()
+{
+    for (int p = 0; p < YOLO11_PRIORITY_NUM; p++)
+    {
+        latency_histogram_t *h = &g_latency[p];
+        for (int b = 0; b <= LATENCY_BUCKETS; b++)
+        {
+            h->buckets[b].store(0);
+        }
+        h->frames.store(0);
+        h->dropped.store(0);
+        h->max_us.store(0);
+    }
+}
+
+void dump_yolo11_latency_stats()
+{
+    static const char *names[YOLO11_PRIORITY_NUM] = {"high", "medium", "low"};
+    for (int p = 0; p < YOLO11_PRIORITY_NUM; p++)
+    {
+        yolo11_latency_stats_t stats;
+        get_yolo11_latency_stats((yolo11_priority_t)p, &stats);
+        if (stats.frames == 0 && stats.dropped == 0)
+        {
+            continue;
+        }
+        printf("priority %-6s: %llu frames, %llu dropped, p50 %.1f ms, p99 %.1f ms, max %.1f ms\n", names[p],
+               (unsigned long long)stats.frames, (unsigned long long)stats.dropped, stats.p50_ms, stats.p99_ms,
+               stats.max_ms);
+    }
+}
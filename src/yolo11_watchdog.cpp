@@ -0,0 +1,345 @@
+#include "yolo11_watchdog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// host deadline on top of the NPU deadline, covers letterbox and post process
+#define WATCHDOG_SLACK_MS 100
+// pause between failed rebuild attempts
+#define WATCHDOG_RETRY_MS 50
+
+// One context and the thread running it, owned by the watchdog until it is
+// abandoned in the driver, then by its own thread
+typedef struct {
+    rknn_app_context_t app_ctx;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    image_buffer_t* img;
+    object_detect_result_list od_results;
+    int ret;
+    bool has_job;
+    bool done;
+    bool abandoned;
+    bool stop;
+} yolo11_watchdog_runner_t;
+
+struct yolo11_watchdog {
+    std::string model_path;
+    rknn_app_context_t options;
+    int timeout_ms;
+    std::mutex mutex;
+    yolo11_watchdog_runner_t* runner; // NULL while a rebuild is running
+    std::thread rebuild_thread;
+    double failure_ms;
+    bool stop;
+    yolo11_watchdog_stats_t stats;
+};
+
+// abandoned contexts whose call has not returned yet, over all watchdogs
+static std::atomic<int> g_hung_contexts(0);
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void runner_loop(yolo11_watchdog_runner_t* runner)
+{
+    std::unique_lock<std::mutex> lock(runner->mutex);
+    for (;;)
+    {
+        while (!runner->stop && !runner->has_job)
+        {
+            runner->cond.wait(lock);
+        }
+        if (!runner->has_job)
+        {
+            return;
+        }
+        image_buffer_t* img = runner->img;
+        lock.unlock();
+
+        object_detect_result_list od_results;
+        int ret = inference_yolo11_model(&runner->app_ctx, img, &od_results);
+
+        lock.lock();
+        // the caller may free the frame as soon as it has the results
+        runner->img = NULL;
+        runner->has_job = false;
+        runner->ret = ret;
+        memcpy(&runner->od_results, &od_results, sizeof(od_results));
+        runner->done = true;
+        if (runner->abandoned)
+        {
+            // the watchdog gave up on this context long ago, the thread is detached
+            lock.unlock();
+            release_yolo11_model(&runner->app_ctx);
+            delete runner;
+            g_hung_contexts.fetch_sub(1);
+            return;
+        }
+        runner->cond.notify_all();
+    }
+}
+
+// Take only the fields set before init_yolo11_model, an initialized context
+// passed as options must not hand its rknn_ctx, memories or scratch to the runners
+static void copy_options(rknn_app_context_t* dst, const rknn_app_context_t* src)
+{
+    memset(dst, 0, sizeof(rknn_app_context_t));
+#if defined(ZERO_COPY)
+    dst->async_depth = src->async_depth;
+    dst->use_fence = src->use_fence;
+    dst->input_ring_size = src->input_ring_size;
+#endif
+    dst->mem_placement = src->mem_placement;
+    dst->share_sram = src->share_sram;
+    dst->output_cache_mode = src->output_cache_mode;
+    dst->device_written_input = src->device_written_input;
+    dst->priority = src->priority;
+    dst->branch_mask = src->branch_mask;
+    dst->min_object_size = src->min_object_size;
+    dst->progressive_cb = src->progressive_cb;
+    dst->progressive_user = src->progressive_user;
+    dst->model_load_mode = src->model_load_mode;
+    dst->collect_perf = src->collect_perf;
+    dst->perf_report_interval = src->perf_report_interval;
+    dst->perf_report_path = src->perf_report_path;
+    dst->batch_core_num = src->batch_core_num;
+}
+
+static yolo11_watchdog_runner_t* create_runner(yolo11_watchdog_t* wd)
+{
+    yolo11_watchdog_runner_t* runner = new yolo11_watchdog_runner_t();
+    memcpy(&runner->app_ctx, &wd->options, sizeof(rknn_app_context_t));
+    runner->app_ctx.run_timeout_ms = wd->timeout_ms;
+    runner->img = NULL;
+    runner->ret = 0;
+    runner->has_job = false;
+    runner->done = false;
+    runner->abandoned = false;
+    runner->stop = false;
+
+    int ret = init_yolo11_model(wd->model_path.c_str(), &runner->app_ctx);
+    if (ret != 0)
+    {
+        printf("watchdog: init_yolo11_model fail! ret=%d\n", ret);
+        release_yolo11_model(&runner->app_ctx);
+        delete runner;
+        return NULL;
+    }
+    runner->thread = std::thread(runner_loop, runner);
+    return runner;
+}
+
+static void destroy_runner(yolo11_watchdog_runner_t* runner)
+{
+    {
+        std::lock_guard<std::mutex> lock(runner->mutex);
+        runner->stop = true;
+    }
+    runner->cond.notify_all();
+    if (runner->thread.joinable())
+    {
+        runner->thread.join();
+    }
+    release_yolo11_model(&runner->app_ctx);
+    delete runner;
+}
+
+// Background rebuild: drop the failed context (unless it is stuck in the driver)
+// and build a new one until it works or the watchdog is released
+static void rebuild_loop(yolo11_watchdog_t* wd, yolo11_watchdog_runner_t* failed)
+{
+    if (failed != NULL)
+    {
+        destroy_runner(failed);
+    }
+
+    yolo11_watchdog_runner_t* runner = NULL;
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(wd->mutex);
+            if (wd->stop)
+            {
+                return;
+            }
+        }
+        runner = create_runner(wd);
+        if (runner != NULL)
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(WATCHDOG_RETRY_MS));
+    }
+
+    std::lock_guard<std::mutex> lock(wd->mutex);
+    double recovery_ms = now_ms() - wd->failure_ms;
+    wd->runner = runner;
+    wd->stats.recoveries++;
+    wd->stats.last_recovery_ms = recovery_ms;
+    if (recovery_ms > wd->stats.max_recovery_ms)
+    {
+        wd->stats.max_recovery_ms = recovery_ms;
+    }
+    printf("watchdog: context rebuilt in %.1f ms (load %.1f ms, rknn_init %.1f ms)\n", recovery_ms,
+           runner->app_ctx.model_load_ms, runner->app_ctx.model_init_ms);
+}
+
+// Take the current context out of service and start rebuilding. A hung
+// context is handed to its own thread, an idle one is released by the rebuild.
+static void start_recovery(yolo11_watchdog_t* wd, yolo11_watchdog_runner_t* runner, bool hung)
+{
+    std::lock_guard<std::mutex> lock(wd->mutex);
+    wd->runner = NULL;
+    wd->failure_ms = now_ms();
+    wd->stats.failures++;
+    if (wd->rebuild_thread.joinable())
+    {
+        // the previous rebuild published its context, so it has finished
+        wd->rebuild_thread.join();
+    }
+    wd->rebuild_thread = std::thread(rebuild_loop, wd, hung ? NULL : runner);
+}
+
+int init_yolo11_watchdog(const char* model_path, const rknn_app_context_t* options, int timeout_ms,
+                         yolo11_watchdog_t** wd)
+{
+    if (model_path == NULL || wd == NULL || timeout_ms <= 0)
+    {
+        return -1;
+    }
+
+    yolo11_watchdog_t* w = new yolo11_watchdog_t();
+    w->model_path = model_path;
+    memset(&w->options, 0, sizeof(w->options));
+    if (options != NULL)
+    {
+        copy_options(&w->options, options);
+    }
+    w->timeout_ms = timeout_ms;
+    w->failure_ms = 0;
+    w->stop = false;
+    memset(&w->stats, 0, sizeof(w->stats));
+
+    w->runner = create_runner(w);
+    if (w->runner == NULL)
+    {
+        delete w;
+        return -1;
+    }
+    printf("watchdog: npu deadline %d ms\n", timeout_ms);
+    *wd = w;
+    return 0;
+}
+
+int yolo11_watchdog_inference(yolo11_watchdog_t* wd, image_buffer_t* img, object_detect_result_list* od_results)
+{
+    if (wd == NULL || img == NULL || od_results == NULL)
+    {
+        return -1;
+    }
+
+    yolo11_watchdog_runner_t* runner;
+    {
+        std::lock_guard<std::mutex> lock(wd->mutex);
+        runner = wd->runner;
+        if (runner == NULL)
+        {
+            wd->stats.dropped++;
+            return YOLO11_FRAME_DROPPED;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(runner->mutex);
+    runner->img = img;
+    runner->done = false;
+    runner->has_job = true;
+    runner->cond.notify_all();
+
+    std::chrono::milliseconds deadline(wd->timeout_ms + WATCHDOG_SLACK_MS);
+    if (!runner->cond.wait_for(lock, deadline, [runner] { return runner->done; }))
+    {
+        // still inside the driver, nothing can safely touch this context now
+        runner->abandoned = true;
+        runner->thread.detach();
+        g_hung_contexts.fetch_add(1);
+        lock.unlock();
+        printf("watchdog: frame missed the %d ms deadline, rebuilding the context\n", wd->timeout_ms);
+        start_recovery(wd, runner, true);
+        return RKNN_ERR_TIMEOUT;
+    }
+
+    int ret = runner->ret;
+    memcpy(od_results, &runner->od_results, sizeof(object_detect_result_list));
+    lock.unlock();
+
+    if (ret == RKNN_ERR_TIMEOUT || ret == RKNN_ERR_DEVICE_UNAVAILABLE)
+    {
+        printf("watchdog: rknn_run failed with %d, rebuilding the context\n", ret);
+        start_recovery(wd, runner, false);
+        return ret;
+    }
+    if (ret == 0)
+    {
+        std::lock_guard<std::mutex> stats_lock(wd->mutex);
+        wd->stats.frames++;
+    }
+    return ret;
+}
+
+int get_yolo11_watchdog_stats(yolo11_watchdog_t* wd, yolo11_watchdog_stats_t* stats)
+{
+    if (wd == NULL || stats == NULL)
+    {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(wd->mutex);
+    memcpy(stats, &wd->stats, sizeof(yolo11_watchdog_stats_t));
+    return 0;
+}
+
+int release_yolo11_watchdog(yolo11_watchdog_t* wd)
+{
+    if (wd == NULL)
+    {
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wd->mutex);
+        wd->stop = true;
+    }
+    if (wd->rebuild_thread.joinable())
+    {
+        wd->rebuild_thread.join();
+    }
+    if (wd->runner != NULL)
+    {
+        destroy_runner(wd->runner);
+        wd->runner = NULL;
+    }
+    printf("watchdog: %llu frames, %llu failures, %llu recoveries (last %.1f ms, max %.1f ms), %llu dropped\n",
+           (unsigned long long)wd->stats.frames, (unsigned long long)wd->stats.failures,
+           (unsigned long long)wd->stats.recoveries, wd->stats.last_recovery_ms, wd->stats.max_recovery_ms,
+           (unsigned long long)wd->stats.dropped);
+    delete wd;
+    return 0;
+}
+
+int get_yolo11_watchdog_hung_contexts()
+{
+    return g_hung_contexts.load();
+}